@@ -6,12 +6,35 @@
 #include "../tokenize/tokenize.h"
 #include "../calculator/parser.h"
 
-int CalculateExpression(std::string_view input) {
-  const auto tokens = Tokenize(input);
-  size_t pos = 0;
-  const auto expression = ParseExpression(tokens, pos);
-  if (pos < tokens.size()) {
-    throw WrongExpressionError("extra tokens detected");
+namespace {
+
+thread_local InfixParser parser;  // стеки разбора переиспользуются между вызовами в потоке
+
+template <class Stream>
+int Calculate(Stream& tokens) {  // выражение вычисляется один раз, поэтому прямо по ходу разбора
+  try {
+    const auto value = parser.Evaluate(tokens);
+    if (!tokens.Empty()) {
+      throw WrongExpressionError("extra tokens detected", tokens.Peek().offset, tokens.Peek().length);
+    }
+    return value.Get();
+  } catch (const UnknownSymbolError&) {  // недопустимый символ дальше по входу важнее ошибки разбора
+    tokens.ScanRest();
+    throw;
+  } catch (const WrongExpressionError&) {
+    tokens.ScanRest();
+    throw;
   }
-  return expression->Calculate();
-}
\ No newline at end of file
+}
+
+}  // namespace
+
+int CalculateExpression(std::string_view input) {
+  TokenStream tokens(input);
+  return Calculate(tokens);
+}
+
+int CalculateExpression(std::istream& input) {
+  ChunkedTokenStream tokens(input);
+  return Calculate(tokens);
+}
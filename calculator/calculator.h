@@ -5,8 +5,14 @@
 
 #ifndef MY_CALCULATOR_H
 #define MY_CALCULATOR_H
+#include <istream>
 #include <string_view>
 
 int CalculateExpression(std::string_view input);
 
+// То же для входа из потока (например, файла на несколько гигабайт): выражение читается фрагментами
+// и вычисляется по ходу разбора, так что память ограничена глубиной вложенности, а не длиной входа.
+// Ошибки те же, что у перегрузки для строки: перед ошибкой разбора вход дочитывается до конца
+int CalculateExpression(std::istream& input);
+
 #endif  // MY_CALCULATOR_H
\ No newline at end of file
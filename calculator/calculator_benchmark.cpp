@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "calculator.h"
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+
+// Генерация корректного инфиксного выражения из terms слагаемых со скобками небольшой глубины
+static std::string GenerateExpression(size_t terms) {
+  static constexpr std::string_view kOperators[] = {" + ", " - ", " * ", " / ", " % "};
+  std::mt19937 generator(42);
+  std::string input;
+  size_t depth = 0;
+  for (size_t i = 0; i < terms; ++i) {
+    if (depth < 8 && generator() % 4 == 0) {
+      input += "( ";
+      ++depth;
+    }
+    input += std::to_string(1 + generator() % 1000);
+    if (depth > 0 && generator() % 4 == 0) {
+      input += " )";
+      --depth;
+    }
+    if (i + 1 < terms) {
+      input += kOperators[generator() % std::size(kOperators)];
+    }
+  }
+  input.append(depth, ')');
+  return input;
+}
+
+// Возвращает лучшее из нескольких измерений время одного вызова function в наносекундах
+template <class Function>
+static double Measure(size_t repeats, Function function) {
+  constexpr size_t kAttempts = 5;
+  double best = 1e300;
+  for (size_t attempt = 0; attempt < kAttempts; ++attempt) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeats; ++i) {
+      function();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / static_cast<double>(repeats));
+  }
+  return best;
+}
+
+int main() {
+  const auto long_input = GenerateExpression(100'000);
+  const auto tokens = Tokenize(long_input);
+  std::cout << "ParseExpression, " << tokens.size() << " tokens: " << Measure(10, [&tokens] {
+    size_t pos = 0;
+    return ParseExpression(tokens, pos);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  InfixParser parser;
+  std::cout << "InfixParser, " << tokens.size() << " tokens: " << Measure(10, [&tokens, &parser] {
+    size_t pos = 0;
+    return parser.Parse(tokens, pos);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  ExpressionArena arena;
+  std::cout << "InfixParser in ExpressionArena: " << Measure(10, [&tokens, &parser, &arena] {
+    arena.Reset();
+    ExpressionArena::Scope scope(arena);
+    size_t pos = 0;
+    (void)parser.Parse(tokens, pos);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  Program program;
+  std::cout << "InfixParser::Compile, " << tokens.size() << " tokens: " << Measure(10, [&tokens, &parser, &program] {
+    size_t pos = 0;
+    parser.Compile(tokens, pos, program);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  const auto short_input = GenerateExpression(8);
+  std::cout << "CalculateExpression(\"" << short_input << "\"): " << Measure(100'000, [&short_input] {
+    return CalculateExpression(short_input);
+  }) << " ns\n";
+
+  std::string huge_input = "0";  // без деления на ноль: вычитаются только частные
+  for (size_t i = 1; i < 2'000'000; ++i) {
+    huge_input += i % 2 ? " + " + std::to_string(i % 1000) : " - ( " + std::to_string(i % 1000) + " / 3 )";
+  }
+  const auto megabytes = static_cast<double>(huge_input.size()) / 1e6;
+  std::cout << "CalculateExpression(std::string_view), " << megabytes << " MB: "
+            << megabytes / Measure(1, [&huge_input] { return CalculateExpression(std::string_view(huge_input)); }) * 1e9
+            << " MB/s\n";
+  std::cout << "CalculateExpression(std::istream&), " << megabytes << " MB: " << megabytes / Measure(1, [&huge_input] {
+    std::istringstream stream(huge_input);
+    return CalculateExpression(stream);
+  }) * 1e9 << " MB/s\n";
+  return 0;
+}
@@ -7,6 +7,7 @@
 #define CATCH_CONFIG_MAIN
 
 #include <catch.hpp>
+#include <sstream>
 #include "calculator.h"
 #include "parser.h"
 
@@ -139,4 +140,192 @@ TEST_CASE("Exceptions", "[Calculator]") {
   REQUIRE_THROWS_AS((void)CalculateExpression("( 10 - 5 ) ( 5 * 10 )"), WrongExpressionError);  // NOLINT
   REQUIRE_THROWS_AS((void)CalculateExpression("( 10 - 5 + ( 5 * 10 )"), WrongExpressionError);  // NOLINT
   REQUIRE_THROWS_AS((void)CalculateExpression("10 * 8 - 9 ! 9"), std::runtime_error);           // NOLINT
+  REQUIRE_THROWS_AS((void)CalculateExpression("1 + 2147483648"), std::runtime_error);           // NOLINT
+}
+
+TEST_CASE("Stream", "[ParseExpression]") {
+  TokenStream tokens("( 4 / ( -2 ) * ( 3 + ( 5 ) ) - 64 % 9 ) )");
+  const auto expression = ParseFactor(tokens);
+
+  REQUIRE(expression->Calculate() == -17);
+  REQUIRE(tokens.Next().kind == TokenKind::kClosingBracket);
+  REQUIRE(tokens.Empty());
+}
+
+TEST_CASE("ErrorSpans", "[Calculator]") {
+  const auto span_of = [](std::string_view input) -> std::pair<size_t, size_t> {
+    try {
+      (void)CalculateExpression(input);
+    } catch (const UnknownSymbolError& error) {
+      return {error.Offset(), error.Length()};
+    } catch (const WrongExpressionError& error) {
+      return {error.Offset(), error.Length()};
+    }
+    return {std::string_view::npos, 0};
+  };
+  REQUIRE(span_of("1 + foo * 2") == std::pair<size_t, size_t>{4, 3});
+  REQUIRE(span_of("1 + 2 bar") == std::pair<size_t, size_t>{6, 3});
+  REQUIRE(span_of("1 + ( 2 * 3") == std::pair<size_t, size_t>{4, 1});
+  REQUIRE(span_of("1 + 2 ) * 3") == std::pair<size_t, size_t>{6, 1});
+  REQUIRE(span_of("1 + 22 33") == std::pair<size_t, size_t>{7, 2});
+  REQUIRE(span_of("1 + ") == std::pair<size_t, size_t>{4, 0});
+  REQUIRE(span_of("1 + 2") == std::pair<size_t, size_t>{std::string_view::npos, 0});
+}
+
+TEST_CASE("ErrorPrecedence", "[Calculator]") {  // недопустимый символ в любом месте входа важнее ошибки разбора
+  const auto position_of = [](std::string_view input) -> size_t {
+    try {
+      (void)CalculateExpression(input);
+    } catch (const TokenizeError& error) {
+      return error.Position();
+    }
+    return std::string_view::npos;
+  };
+  REQUIRE(position_of("1 2 #") == 4);
+  REQUIRE(position_of("1 + foo #") == 8);
+  REQUIRE(position_of("( 1 + 2 ) ) 3 # 4") == 14);
+  REQUIRE(position_of("1 + # 2 #") == 4);
+  REQUIRE_THROWS_AS((void)CalculateExpression("1 2 3"), WrongExpressionError);
+  REQUIRE_THROWS_AS((void)CalculateExpression("1 + foo 2"), UnknownSymbolError);
+}
+
+TEST_CASE("Associativity", "[Calculator]") {
+  REQUIRE(CalculateExpression("20 - 5 - 3 - 2") == 10);
+  REQUIRE(CalculateExpression("100 / 10 / 5") == 2);
+  REQUIRE(CalculateExpression("100 % 30 % 7") == 3);
+  REQUIRE(CalculateExpression("2 + 3 * 4 - 10 / 5 % 3") == 12);
+  REQUIRE(CalculateExpression("- - 3 * - 2") == -6);
+  REQUIRE(CalculateExpression("abs sqr - 4 - 1") == -5);
+}
+
+TEST_CASE("DeepNesting", "[InfixParser]") {
+  constexpr size_t kDepth = 1'000'000;
+  const auto input = std::string(kDepth, '(') + "7" + std::string(kDepth, ')') + " * 6";
+  REQUIRE(CalculateExpression(input) == 42);
+  REQUIRE_THROWS_AS((void)CalculateExpression(std::string(kDepth, '(') + "7" + std::string(kDepth - 1, ')')),
+                    WrongExpressionError);
+}
+
+TEST_CASE("InfixParser", "[InfixParser]") {
+  InfixParser parser;
+  parser.Reserve(16);
+  for (const auto* input : {"1 + 2 * 3 - 4", "( 4 / ( -2 ) * ( 3 + ( 5 ) ) - 64 % 9 )", "- ( 7 - 10 ) * sqr 2",
+                            "abs - 5 % 3", "100 / 10 / 5 - 2 - 1"}) {
+    TokenStream stream(input);
+    TokenStream reference(input);
+    REQUIRE(parser.Parse(stream)->Calculate() == ParseExpression(reference)->Calculate());
+  }
+
+  const auto tokens = Tokenize("2 * 3 ) + 4");
+  size_t pos = 0;
+  REQUIRE(parser.Parse(tokens, pos)->Calculate() == 6);
+  REQUIRE(pos == 3);
+}
+
+TEST_CASE("Bytecode", "[InfixParser]") {
+  InfixParser parser;
+  Program program;
+  for (const auto* input : {"1 + 2 * 3 - 4", "( 4 / ( -2 ) * ( 3 + ( 5 ) ) - 64 % 9 )", "- ( 7 - 10 ) * sqr 2",
+                            "abs - 5 % 3", "100 / 10 / 5 - 2 - 1", "+ + 8"}) {
+    TokenStream stream(input);
+    TokenStream reference(input);
+    parser.Compile(stream, program);
+    REQUIRE(Execute(program) == ParseExpression(reference)->Calculate());
+  }
+
+  const auto tokens = Tokenize("2 * - 3 ) + 4");
+  size_t pos = 0;
+  parser.Compile(tokens, pos, program);
+  REQUIRE(pos == 4);
+  REQUIRE(program.code.size() == 4);
+  REQUIRE(program.code[2].op == OpCode::kNegate);
+  REQUIRE(Execute(program) == -6);
+}
+
+TEST_CASE("DeepTeardown", "[IExpression]") {
+  std::string input = "1";
+  for (size_t i = 1; i < 1'000'000; ++i) {
+    input += " + 1";
+  }
+  TokenStream tokens(input);
+  auto expression = InfixParser().Parse(tokens);
+  REQUIRE(tokens.Empty());
+  expression.reset();  // цепочка из миллиона узлов уничтожается без рекурсии
+
+  const auto negations = std::string(1'000'000, '-') + "5";
+  TokenStream minus_tokens(negations);
+  REQUIRE(InfixParser().Parse(minus_tokens) != nullptr);
+}
+
+TEST_CASE("Streaming", "[Calculator]") {
+  const auto calculate = [](const std::string& input) {
+    std::istringstream stream(input);
+    return CalculateExpression(stream);
+  };
+  for (const auto* input : {"  11 ", "+ 5", "5 + + 5", " ( ( (   ( -100  )  ) )   ) ", " 10 + -4 - 5 % 4 * 7",
+                            "( ( 1 + ( 2 + ( 3 + ( 4 + ( 5 )  ) ) ) ) % ( ( 10 ) ) ) ", "( 5 + 3 ) * ( -5 - -7 )",
+                            "1 * ( ( ( 2 * 3 ) * ( 4 + 5 ) + 6 + 7 ) * ( 8 * 9 + 10 * 11 ) * 12 )", "abs sqr - 4 - 1"}) {
+    REQUIRE(calculate(input) == CalculateExpression(std::string_view(input)));
+  }
+
+  // длинный вход читается фрагментами, и числа со словами на границах фрагментов склеиваются
+  std::string input = "0";
+  int expected = 0;
+  for (int i = 1; i < 100'000; ++i) {
+    input += i % 2 ? " + " + std::to_string(i) : " - ( " + std::to_string(i) + " / 2 )";
+    expected += i % 2 ? i : -(i / 2);
+  }
+  REQUIRE(calculate(input) == expected);
+
+  const auto deep = std::string(1'000'000, '(') + "7" + std::string(1'000'000, ')');
+  REQUIRE(calculate(deep) == 7);
+
+  for (const auto* input : {"", "(", "( )", "5 5", "( 10 - 5 ) ( 5 * 10 )", "( 10 - 5 + ( 5 * 10 )"}) {
+    REQUIRE_THROWS_AS(calculate(input), WrongExpressionError);
+  }
+  REQUIRE_THROWS_AS(calculate("1 / 0 )"), WrongExpressionError);  // деление на ноль откладывается
+  REQUIRE_THROWS_AS(calculate("1 / 0 + foo"), UnknownSymbolError);
+  REQUIRE_THROWS_AS(calculate("1 + 2147483648"), std::runtime_error);
+
+  std::string unknown(ChunkedTokenStream::kDefaultChunkSize - 6, ' ');  // слово на границе фрагментов
+  unknown += "1 + foobar";
+  try {
+    (void)calculate(unknown);
+    FAIL("unknown word is not reported");
+  } catch (const UnknownSymbolError& error) {
+    REQUIRE(std::string(error.what()) == "UnknownSymbolError: Unknown token: foobar");
+    REQUIRE(error.Offset() == ChunkedTokenStream::kDefaultChunkSize - 2);
+    REQUIRE(error.Length() == 6);
+  }
+
+  try {  // слово длиннее трех фрагментов сообщается своим началом
+    (void)calculate("1 + " + std::string(200'000, 'q'));
+    FAIL("unknown word is not reported");
+  } catch (const UnknownSymbolError& error) {
+    REQUIRE(std::string(error.what()) ==
+            "UnknownSymbolError: Unknown token: " + std::string(ChunkedTokenizer::kWordPrefix, 'q'));
+    REQUIRE(error.Offset() == 4);
+  }
+}
+
+TEST_CASE("StreamingErrors", "[Calculator]") {  // обе перегрузки сообщают об ошибке во входе одинаково
+  const auto error_of = [](const auto& calculate) -> std::string {
+    try {
+      (void)calculate();
+    } catch (const std::runtime_error& error) {
+      return error.what();
+    }
+    return "no error";
+  };
+  const std::string far_gap(ChunkedTokenStream::kDefaultChunkSize + 10, ' ');  // ошибка в следующем фрагменте
+  for (const auto& input : {std::string("1 2 #"), std::string("1 + foo #"), std::string("( 1 + 2 ) ) 3 # 4"),
+                            std::string("1 + # 2"), std::string("1 2 3"), std::string("1 + foo 2"),
+                            std::string("( 1 + 2"), std::string("1 + 2147483648 )"), "1 2" + far_gap + "#",
+                            "1 + foo" + far_gap + "#", "( 1" + far_gap + "99999999999"}) {
+    INFO(input.substr(0, 20));
+    std::istringstream stream(input);
+    const auto expected = error_of([&input] { return CalculateExpression(std::string_view(input)); });
+    REQUIRE(expected != "no error");
+    REQUIRE(error_of([&stream] { return CalculateExpression(stream); }) == expected);
+  }
 }
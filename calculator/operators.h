@@ -0,0 +1,50 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_OPERATORS_H
+#define MY_OPERATORS_H
+
+#include "../tokenize/tokenize.h"
+#include <array>
+
+// Таблица операций инфиксной грамматики. Парсеры не знают о конкретных операциях: новая операция
+// или новый уровень приоритета добавляется одной строкой в MakeOperatorTable, а узел дерева или
+// инструкцию по виду токена создает построитель (bytecode.h)
+
+enum class Associativity : uint8_t { kLeft, kRight };
+
+struct OperatorInfo {
+  uint8_t binding_power = 0;  // сила связывания бинарной операции; 0 — токен не бинарная операция
+  Associativity associativity = Associativity::kLeft;
+  bool prefix = false;       // может стоять перед операндом как унарная операция
+  bool prefix_node = false;  // унарная операция создает узел; иначе операнд возвращается как есть
+};
+
+inline constexpr uint8_t kAdditivePower = 1;        // + -
+inline constexpr uint8_t kMultiplicativePower = 2;  // * / %
+
+inline constexpr size_t kTokenKindCount = static_cast<size_t>(TokenKind::kUnknown) + 1;
+
+constexpr std::array<OperatorInfo, kTokenKindCount> MakeOperatorTable() {
+  std::array<OperatorInfo, kTokenKindCount> table{};
+  const auto at = [&table](TokenKind kind) -> OperatorInfo& { return table[static_cast<size_t>(kind)]; };
+  at(TokenKind::kPlus) = {kAdditivePower, Associativity::kLeft, true, false};
+  at(TokenKind::kMinus) = {kAdditivePower, Associativity::kLeft, true, true};
+  at(TokenKind::kMultiply) = {kMultiplicativePower, Associativity::kLeft};
+  at(TokenKind::kDivide) = {kMultiplicativePower, Associativity::kLeft};
+  at(TokenKind::kResidual) = {kMultiplicativePower, Associativity::kLeft};
+  // sqr и abs в инфиксной записи исторически не меняют операнд
+  at(TokenKind::kSqr).prefix = true;
+  at(TokenKind::kAbs).prefix = true;
+  return table;
+}
+
+inline constexpr auto kOperators = MakeOperatorTable();
+
+inline const OperatorInfo& OperatorOf(TokenKind kind) {
+  return kOperators[static_cast<size_t>(kind)];
+}
+
+#endif  // MY_OPERATORS_H
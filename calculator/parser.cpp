@@ -4,90 +4,230 @@
 // Подробности смотрите в файле LICENSE
 
 #include "../calculator/parser.h"
+#include "../calculator/operators.h"
+#include "../polish_notation/bytecode.h"
 
-std::unique_ptr<IExpression> ParseExpression(const std::vector<Token>& tokens, size_t& pos) { // обрабатывает выр-ия с операциями сложения и вычитания
-  if (pos >= tokens.size()) {
-    throw WrongExpressionError("too few arguments");
-  }
-  auto expression = ParseTerm(tokens, pos); // анализ компоненты выражения
-  while (pos < tokens.size()) {
-    const auto& token = tokens[pos];
-    if (std::holds_alternative<PlusToken>(token)) {
-      expression = std::make_unique<Sum>(std::move(expression), ParseTerm(tokens, ++pos));
-    } else if (std::holds_alternative<MinusToken>(token)) {
-      expression = std::make_unique<Subtract>(std::move(expression), ParseTerm(tokens, ++pos));
-    } else if (std::holds_alternative<UnknownToken>(token)) {
-      throw UnknownSymbolError("Unknown symbol: " + std::get<UnknownToken>(token).value);
-    } else {
+namespace {
+
+template <class Tokens>
+std::unique_ptr<IExpression> ParsePrefix(Tokens& tokens);
+
+// Разбор по Пратту: операнд, затем бинарные операции с силой связывания не меньше min_power.
+// Приоритеты и ассоциативность берутся из таблицы kOperators, так что каждая операция стоит
+// одного вызова независимо от числа уровней приоритета
+template <class Tokens>
+std::unique_ptr<IExpression> ParseBinary(Tokens& tokens, uint8_t min_power) {
+  auto left = ParsePrefix(tokens);
+  while (!tokens.Empty()) {
+    const auto token = tokens.Peek();
+    if (token.kind == TokenKind::kUnknown) {
+      throw UnknownSymbolError("Unknown symbol: " + std::string(tokens.Text(token)), token.offset,
+                               token.length);
+    }
+    const auto& info = OperatorOf(token.kind);
+    if (info.binding_power == 0 || info.binding_power < min_power) {
       break;
     }
+    tokens.Next();
+    const auto right_power = info.associativity == Associativity::kLeft ? info.binding_power + 1 : info.binding_power;
+    left = MakeBinaryNode(token.kind, std::move(left), ParseBinary(tokens, right_power));
   }
-  return expression;
+  return left;
 }
 
-std::unique_ptr<IExpression> ParseTerm(const std::vector<Token>& tokens, size_t& pos) {  // обрабатывает *, /, %
-  if (pos >= tokens.size()) {
-    throw WrongExpressionError("too few arguments");
+template <class Tokens>
+std::unique_ptr<IExpression> ParsePrefix(Tokens& tokens) {  // число, скобки и унарные операции
+  if (tokens.Empty()) {
+    throw WrongExpressionError("too few arguments", tokens.Offset(), 0);
   }
-  auto summand = ParseFactor(tokens, pos);
-  while (pos < tokens.size()) {
-    const auto& token = tokens[pos];
-    if (std::holds_alternative<MultiplyToken>(token)) {
-      summand = std::make_unique<Multiply>(std::move(summand), ParseFactor(tokens, ++pos));
-    } else if (std::holds_alternative<DivideToken>(token)) {
-      summand = std::make_unique<Divide>(std::move(summand), ParseFactor(tokens, ++pos));
-    } else if (std::holds_alternative<ResidualToken>(token)) {
-      summand = std::make_unique<Residual>(std::move(summand), ParseFactor(tokens, ++pos));
-    } else if (std::holds_alternative<UnknownToken>(token)) {
-      throw UnknownSymbolError("Unknown symbol: " + std::get<UnknownToken>(token).value);
-    } else {
-      break;
+  const auto token = tokens.Next();
+
+  switch (token.kind) {
+    case TokenKind::kNumber:
+      return std::make_unique<Constant>(token.value);
+    case TokenKind::kOpeningBracket: {
+      auto sub_expression = ParseBinary(tokens, kAdditivePower);
+      if (tokens.Empty() || tokens.Next().kind != TokenKind::kClosingBracket) {
+        throw WrongExpressionError("No matching )", token.offset, token.length);  // указывает на открывающую скобку
+      }
+      return sub_expression;
     }
+    case TokenKind::kUnknown:
+      throw UnknownSymbolError("Unknown token: " + std::string(tokens.Text(token)), token.offset, token.length);
+    case TokenKind::kClosingBracket:
+      throw WrongExpressionError("No matching (", token.offset, token.length);
+    default:
+      break;
   }
-  return summand;
-}
 
-std::unique_ptr<IExpression> ParseFactor(const std::vector<Token>& tokens, size_t& pos) { // обрабатывает все остальное
-  if (pos >= tokens.size()) {
-    throw WrongExpressionError("too few arguments");
+  const auto& info = OperatorOf(token.kind);
+  if (!info.prefix) {
+    throw WrongExpressionError("Invalid token", token.offset, token.length);
   }
-  const auto& token = tokens[pos++];
+  auto operand = ParsePrefix(tokens);
+  return info.prefix_node ? MakeUnaryNode(token.kind, std::move(operand)) : std::move(operand);
+}
 
-  if (std::holds_alternative<UnknownToken>(token)) {
-    throw UnknownSymbolError("Unknown token: " + std::get<UnknownToken>(token).value);
-  }
+}  // namespace
+
+std::unique_ptr<IExpression> ParseExpression(const std::vector<Token>& tokens, size_t& pos) {
+  TokenCursor cursor(tokens, pos);
+  return ParseBinary(cursor, kAdditivePower);
+}
+
+std::unique_ptr<IExpression> ParseTerm(const std::vector<Token>& tokens, size_t& pos) {
+  TokenCursor cursor(tokens, pos);
+  return ParseBinary(cursor, kMultiplicativePower);
+}
+
+std::unique_ptr<IExpression> ParseFactor(const std::vector<Token>& tokens, size_t& pos) {
+  TokenCursor cursor(tokens, pos);
+  return ParsePrefix(cursor);
+}
+
+std::unique_ptr<IExpression> ParseExpression(TokenStream& tokens) {
+  return ParseBinary(tokens, kAdditivePower);
+}
+
+std::unique_ptr<IExpression> ParseTerm(TokenStream& tokens) {
+  return ParseBinary(tokens, kMultiplicativePower);
+}
+
+std::unique_ptr<IExpression> ParseFactor(TokenStream& tokens) {
+  return ParsePrefix(tokens);
+}
+
+void InfixParser::Reserve(size_t depth) {
+  operands_.reserve(depth);
+  values_.reserve(depth);
+  operators_.reserve(depth);
+}
 
-  if (std::holds_alternative<ClosingBracketToken>(token)) {
-    throw WrongExpressionError("No matching (");
+template <class Builder>
+void InfixParser::ReduceUnary(Builder& builder) {  // применяет унарные операции, ждущие только что законченный операнд
+  while (!operators_.empty() && operators_.back().unary) {
+    builder.Unary(operators_.back().token.kind);
+    operators_.pop_back();
   }
+}
 
-  if (std::holds_alternative<OpeningBracketToken>(token)) {
-    auto sub_expression = ParseExpression(tokens, pos);
-    if (pos >= tokens.size() || !std::holds_alternative<ClosingBracketToken>(tokens[pos++])) {
-      throw WrongExpressionError("No matching )");
+template <class Builder>
+void InfixParser::ReduceBinary(Builder& builder, uint8_t min_power) {  // сворачивает бинарные операции до скобки
+  while (!operators_.empty() && operators_.back().token.kind != TokenKind::kOpeningBracket) {  // или более слабой
+    const auto kind = operators_.back().token.kind;
+    if (OperatorOf(kind).binding_power < min_power) {
+      break;
     }
-    return sub_expression;
+    builder.Binary(kind);
+    operators_.pop_back();
   }
+}
 
-  if (std::holds_alternative<NumberToken>(token)) {
-    return std::make_unique<Constant>(std::get<NumberToken>(token).value);
-  }
+template <class Tokens, class Builder>
+auto InfixParser::ParseImpl(Tokens& tokens, Builder& builder) {
+  operators_.clear();
+  size_t brackets = 0;  // сколько открывающих скобок лежит в operators_
 
-  if (std::holds_alternative<SqrToken>(token)) {
-    return ParseFactor(tokens, pos);
-  }
+  while (true) {
+    // ожидается операнд: число, скобка или унарная операция
+    if (tokens.Empty()) {
+      throw WrongExpressionError("too few arguments", tokens.Offset(), 0);
+    }
+    const auto token = tokens.Next();
+    switch (token.kind) {
+      case TokenKind::kNumber:
+        builder.Number(token.value);
+        break;
+      case TokenKind::kOpeningBracket:
+        operators_.push_back({token, false});
+        ++brackets;
+        continue;
+      case TokenKind::kUnknown:
+        throw UnknownSymbolError("Unknown token: " + std::string(tokens.Text(token)), token.offset, token.length);
+      case TokenKind::kClosingBracket:
+        throw WrongExpressionError("No matching (", token.offset, token.length);
+      default: {
+        const auto& info = OperatorOf(token.kind);
+        if (!info.prefix) {
+          throw WrongExpressionError("Invalid token", token.offset, token.length);
+        }
+        if (info.prefix_node) {
+          operators_.push_back({token, true});
+        }
+        continue;
+      }
+    }
 
-  if (std::holds_alternative<AbsToken>(token)) {
-    return ParseFactor(tokens, pos);
+    // операнд закончен: закрываем скобки и ищем бинарную операцию
+    CompactToken next{};
+    bool has_next = false;
+    while (true) {
+      ReduceUnary(builder);
+      has_next = !tokens.Empty();
+      if (!has_next) {
+        break;
+      }
+      next = tokens.Peek();
+      if (next.kind != TokenKind::kClosingBracket || brackets == 0) {
+        break;
+      }
+      tokens.Next();
+      ReduceBinary(builder, kAdditivePower);
+      operators_.pop_back();  // открывающая скобка
+      --brackets;
+    }
+    if (has_next && next.kind == TokenKind::kUnknown) {
+      throw UnknownSymbolError("Unknown symbol: " + std::string(tokens.Text(next)), next.offset, next.length);
+    }
+    const auto* info = has_next ? &OperatorOf(next.kind) : nullptr;
+    if (info == nullptr || info->binding_power == 0) {
+      if (brackets > 0) {  // внутри скобок выражение может закончиться только закрывающей скобкой
+        if (has_next) {
+          tokens.Next();
+        }
+        auto bracket = operators_.rbegin();
+        while (bracket->token.kind != TokenKind::kOpeningBracket) {
+          ++bracket;
+        }
+        throw WrongExpressionError("No matching )", bracket->token.offset, bracket->token.length);
+      }
+      ReduceBinary(builder, kAdditivePower);
+      return builder.Result();
+    }
+    ReduceBinary(builder, info->associativity == Associativity::kLeft ? info->binding_power : info->binding_power + 1);
+    tokens.Next();
+    operators_.push_back({next, false});
   }
+}
 
-  if (std::holds_alternative<PlusToken>(token)) {
-    return ParseFactor(tokens, pos);
-  }
+std::unique_ptr<IExpression> InfixParser::Parse(const std::vector<Token>& tokens, size_t& pos) {
+  TokenCursor cursor(tokens, pos);
+  TreeBuilder builder(operands_);
+  return ParseImpl(cursor, builder);
+}
 
-  if (std::holds_alternative<MinusToken>(token)) {
-    auto arg = ParseFactor(tokens, pos);
-    return std::make_unique<Minus>(std::move(arg));
-  }
-  throw WrongExpressionError("Invalid token");
-}
\ No newline at end of file
+std::unique_ptr<IExpression> InfixParser::Parse(TokenStream& tokens) {
+  TreeBuilder builder(operands_);
+  return ParseImpl(tokens, builder);
+}
+
+void InfixParser::Compile(const std::vector<Token>& tokens, size_t& pos, Program& program) {
+  TokenCursor cursor(tokens, pos);
+  ProgramBuilder builder(program);
+  ParseImpl(cursor, builder);
+}
+
+void InfixParser::Compile(TokenStream& tokens, Program& program) {
+  ProgramBuilder builder(program);
+  ParseImpl(tokens, builder);
+}
+
+DeferredValue InfixParser::Evaluate(TokenStream& tokens) {
+  ValueBuilder builder(values_);
+  return ParseImpl(tokens, builder);
+}
+
+DeferredValue InfixParser::Evaluate(ChunkedTokenStream& tokens) {
+  ValueBuilder builder(values_);
+  return ParseImpl(tokens, builder);
+}
@@ -8,19 +8,50 @@
 
 #include "../tokenize/tokenize.h"
 #include "../polish_notation/expressions.h"
+#include "../polish_notation/bytecode.h"
 #include <string>
 #include <stdexcept>
 
 class UnknownSymbolError : public std::runtime_error {  // если неизвестный символ
+  size_t offset_ = 0;  // положение ошибочного фрагмента во входной строке
+  size_t length_ = 0;
+
  public:
   explicit UnknownSymbolError(const std::string& symbol = "") : std::runtime_error("UnknownSymbolError: " + symbol) {
   }
+
+  UnknownSymbolError(const std::string& symbol, size_t offset, size_t length)
+      : std::runtime_error("UnknownSymbolError: " + symbol), offset_(offset), length_(length) {
+  }
+
+  size_t Offset() const {
+    return offset_;
+  }
+
+  size_t Length() const {
+    return length_;
+  }
 };
 
 class WrongExpressionError : public std::runtime_error {  // если неверная структура выражения
+  size_t offset_ = 0;  // положение ошибочного фрагмента во входной строке
+  size_t length_ = 0;
+
  public:
   explicit WrongExpressionError(const std::string& msg = "") : std::runtime_error("WrongExpressionError: " + msg) {
   }
+
+  WrongExpressionError(const std::string& msg, size_t offset, size_t length)
+      : std::runtime_error("WrongExpressionError: " + msg), offset_(offset), length_(length) {
+  }
+
+  size_t Offset() const {
+    return offset_;
+  }
+
+  size_t Length() const {
+    return length_;
+  }
 };
 
 std::unique_ptr<IExpression> ParseExpression(const std::vector<Token>& tokens, size_t& pos);
@@ -29,4 +60,54 @@ std::unique_ptr<IExpression> ParseTerm(const std::vector<Token>& tokens, size_t&
 
 std::unique_ptr<IExpression> ParseFactor(const std::vector<Token>& tokens, size_t& pos);
 
+// Перегрузки, забирающие токены из ленивого потока без промежуточного вектора
+std::unique_ptr<IExpression> ParseExpression(TokenStream& tokens);
+
+std::unique_ptr<IExpression> ParseTerm(TokenStream& tokens);
+
+std::unique_ptr<IExpression> ParseFactor(TokenStream& tokens);
+
+// Нерекурсивный разбор методом сортировочной станции: скобки и операции копятся в собственных стеках
+// объекта, поэтому глубина вложенности ограничена только памятью, а не стеком потока. Разбирает то же,
+// что ParseExpression, с теми же деревьями и ошибками. Объект можно переиспользовать: стеки не
+// освобождаются между вызовами, и после Reserve или прогрева разбор не выделяет под них память
+class InfixParser {
+  struct PendingOperator {
+    CompactToken token;  // операция или открывающая скобка
+    bool unary;
+  };
+
+  std::vector<std::unique_ptr<IExpression>> operands_;
+  std::vector<int> values_;
+  std::vector<PendingOperator> operators_;
+
+  template <class Tokens, class Builder>
+  auto ParseImpl(Tokens& tokens, Builder& builder);
+
+  template <class Builder>
+  void ReduceUnary(Builder& builder);
+
+  template <class Builder>
+  void ReduceBinary(Builder& builder, uint8_t min_power);
+
+ public:
+  void Reserve(size_t depth);  // depth — ожидаемая глубина вложенности и длина цепочек операций
+
+  std::unique_ptr<IExpression> Parse(const std::vector<Token>& tokens, size_t& pos);
+
+  std::unique_ptr<IExpression> Parse(TokenStream& tokens);
+
+  // Разбор сразу в постфиксную программу (bytecode.h) без построения дерева; program перезаписывается
+  void Compile(const std::vector<Token>& tokens, size_t& pos, Program& program);
+
+  void Compile(TokenStream& tokens, Program& program);
+
+  // Вычисление по ходу разбора без дерева и программы: память — только стеки глубиной порядка
+  // вложенности выражения, поэтому вход из ChunkedTokenStream любой длины вычисляется в
+  // ограниченной памяти. Результат (DeferredValue::Get) и ошибки те же, что у Compile с последующим Execute
+  DeferredValue Evaluate(TokenStream& tokens);
+
+  DeferredValue Evaluate(ChunkedTokenStream& tokens);
+};
+
 #endif  // MY_PARSER_H
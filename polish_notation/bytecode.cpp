@@ -0,0 +1,453 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../polish_notation/bytecode.h"
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+
+namespace {
+
+struct NodeKind {
+  TokenKind kind;  // вид токена, которым операция узла выдается в ProgramBuilder
+  bool unary;
+};
+
+NodeKind KindOf(const IExpression& node) {
+  const auto& type = typeid(node);
+  if (type == typeid(Minus)) {
+    return {TokenKind::kMinus, true};
+  }
+  if (type == typeid(Plus)) {
+    return {TokenKind::kPlus, true};
+  }
+  if (type == typeid(Square)) {
+    return {TokenKind::kSqr, true};
+  }
+  if (type == typeid(AbsoluteValue)) {
+    return {TokenKind::kAbs, true};
+  }
+  if (type == typeid(Sum)) {
+    return {TokenKind::kPlus, false};
+  }
+  if (type == typeid(Subtract)) {
+    return {TokenKind::kMinus, false};
+  }
+  if (type == typeid(Multiply)) {
+    return {TokenKind::kMultiply, false};
+  }
+  if (type == typeid(Divide)) {
+    return {TokenKind::kDivide, false};
+  }
+  if (type == typeid(Residual)) {
+    return {TokenKind::kResidual, false};
+  }
+  if (type == typeid(Minimum)) {
+    return {TokenKind::kMin, false};
+  }
+  if (type == typeid(Maximum)) {
+    return {TokenKind::kMax, false};
+  }
+  throw std::invalid_argument(std::string("Compile: unsupported expression node ") + type.name());
+}
+
+// Шаг обхода: узел, который нужно обойти, или (node == nullptr) операция, аргументы которой уже выданы
+struct PendingStep {
+  const IExpression* node;
+  NodeKind operation;
+};
+
+}  // namespace
+
+void Compile(const IExpression& expression, Program& program) {
+  thread_local std::vector<PendingStep> pending;
+  pending.clear();
+  ProgramBuilder builder(program);
+  pending.push_back({&expression, {}});
+  while (!pending.empty()) {
+    const auto [node, operation] = pending.back();
+    pending.pop_back();
+    if (node == nullptr) {
+      if (operation.unary) {
+        builder.Unary(operation.kind);
+      } else {
+        builder.Binary(operation.kind);
+      }
+      continue;
+    }
+    if (typeid(*node) == typeid(Constant)) {
+      builder.Number(static_cast<const Constant*>(node)->Value());
+      continue;
+    }
+    const auto kind = KindOf(*node);  // классы из expressions.h final, поэтому static_cast ниже корректен
+    pending.push_back({nullptr, kind});
+    if (kind.unary) {
+      pending.push_back({&static_cast<const IUnaryOperation*>(node)->Operand(), {}});
+    } else {
+      const auto* binary = static_cast<const IBinaryOperation*>(node);
+      pending.push_back({&binary->Right(), {}});  // левый аргумент снимается со стека первым
+      pending.push_back({&binary->Left(), {}});
+    }
+  }
+}
+
+int Execute(const Program& program) {
+  if (program.code.empty()) {
+    throw std::invalid_argument("Execute: empty program");
+  }
+  thread_local std::vector<int> stack;  // память стека переиспользуется между вызовами
+  if (stack.size() < program.max_depth) {
+    stack.resize(program.max_depth);
+  }
+  auto* top = stack.data() - 1;  // вершина стека
+  for (const auto& instruction : program.code) {
+    switch (instruction.op) {
+      case OpCode::kPush:
+        *++top = instruction.value;
+        break;
+      case OpCode::kNegate:
+        *top = -*top;
+        break;
+      case OpCode::kSquare:
+        *top = *top * *top;
+        break;
+      case OpCode::kAbs:
+        *top = *top < 0 ? -*top : *top;
+        break;
+      case OpCode::kAdd:
+        --top;
+        top[0] = top[0] + top[1];
+        break;
+      case OpCode::kSubtract:
+        --top;
+        top[0] = top[0] - top[1];
+        break;
+      case OpCode::kMultiply:
+        --top;
+        top[0] = top[0] * top[1];
+        break;
+      case OpCode::kDivide:
+        --top;
+        top[0] = top[0] / top[1];
+        break;
+      case OpCode::kResidual:
+        --top;
+        top[0] = top[0] % top[1];
+        break;
+      case OpCode::kMin:
+        --top;
+        top[0] = top[0] < top[1] ? top[0] : top[1];
+        break;
+      case OpCode::kMax:
+        --top;
+        top[0] = top[0] > top[1] ? top[0] : top[1];
+        break;
+    }
+  }
+  return *top;
+}
+
+namespace {
+
+// Ячейка стека Program при переводе: число, еще не загруженное в регистр, или уже регистр
+struct StackSlot {
+  bool immediate;
+  int32_t value;
+};
+
+RegisterOp RegisterOpOf(OpCode op, bool immediate) {
+  switch (op) {
+    case OpCode::kNegate:
+      return RegisterOp::kNegate;
+    case OpCode::kSquare:
+      return RegisterOp::kSquare;
+    case OpCode::kAbs:
+      return RegisterOp::kAbs;
+    case OpCode::kAdd:
+      return immediate ? RegisterOp::kAddImmediate : RegisterOp::kAdd;
+    case OpCode::kSubtract:
+      return immediate ? RegisterOp::kSubtractImmediate : RegisterOp::kSubtract;
+    case OpCode::kMultiply:
+      return immediate ? RegisterOp::kMultiplyImmediate : RegisterOp::kMultiply;
+    case OpCode::kDivide:
+      return immediate ? RegisterOp::kDivideImmediate : RegisterOp::kDivide;
+    case OpCode::kResidual:
+      return immediate ? RegisterOp::kResidualImmediate : RegisterOp::kResidual;
+    case OpCode::kMin:
+      return immediate ? RegisterOp::kMinImmediate : RegisterOp::kMin;
+    case OpCode::kMax:
+      return immediate ? RegisterOp::kMaxImmediate : RegisterOp::kMax;
+    case OpCode::kPush:  // загрузка числа переводится отдельно
+      break;
+  }
+  throw std::logic_error("RegisterOpOf: not an operation");
+}
+
+int ExecuteSwitch(const RegisterProgram& program, int* r) {
+  for (const auto* ip = program.code.data();; ++ip) {
+    switch (ip->op) {
+      case RegisterOp::kLoad:
+        r[ip->target] = ip->right;
+        break;
+      case RegisterOp::kNegate:
+        r[ip->target] = -r[ip->left];
+        break;
+      case RegisterOp::kSquare:
+        r[ip->target] = r[ip->left] * r[ip->left];
+        break;
+      case RegisterOp::kAbs:
+        r[ip->target] = r[ip->left] < 0 ? -r[ip->left] : r[ip->left];
+        break;
+      case RegisterOp::kAdd:
+        r[ip->target] = r[ip->left] + r[ip->right];
+        break;
+      case RegisterOp::kSubtract:
+        r[ip->target] = r[ip->left] - r[ip->right];
+        break;
+      case RegisterOp::kMultiply:
+        r[ip->target] = r[ip->left] * r[ip->right];
+        break;
+      case RegisterOp::kDivide:
+        r[ip->target] = r[ip->left] / r[ip->right];
+        break;
+      case RegisterOp::kResidual:
+        r[ip->target] = r[ip->left] % r[ip->right];
+        break;
+      case RegisterOp::kMin:
+        r[ip->target] = r[ip->left] < r[ip->right] ? r[ip->left] : r[ip->right];
+        break;
+      case RegisterOp::kMax:
+        r[ip->target] = r[ip->left] > r[ip->right] ? r[ip->left] : r[ip->right];
+        break;
+      case RegisterOp::kAddImmediate:
+        r[ip->target] = r[ip->left] + ip->right;
+        break;
+      case RegisterOp::kSubtractImmediate:
+        r[ip->target] = r[ip->left] - ip->right;
+        break;
+      case RegisterOp::kMultiplyImmediate:
+        r[ip->target] = r[ip->left] * ip->right;
+        break;
+      case RegisterOp::kDivideImmediate:
+        r[ip->target] = r[ip->left] / ip->right;
+        break;
+      case RegisterOp::kResidualImmediate:
+        r[ip->target] = r[ip->left] % ip->right;
+        break;
+      case RegisterOp::kMinImmediate:
+        r[ip->target] = r[ip->left] < ip->right ? r[ip->left] : ip->right;
+        break;
+      case RegisterOp::kMaxImmediate:
+        r[ip->target] = r[ip->left] > ip->right ? r[ip->left] : ip->right;
+        break;
+      case RegisterOp::kReturn:
+        return r[ip->left];
+    }
+  }
+}
+
+#if defined(__GNUC__)
+// Адреса меток (&&label) и goto * — расширение GCC и Clang
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+int ExecuteThreaded(const RegisterProgram& program, int* r) {
+  static void* const kHandlers[] = {  // в порядке RegisterOp
+      &&load,       &&negate,        &&square,        &&abs,         &&add,           &&subtract,
+      &&multiply,   &&divide,        &&residual,      &&min,         &&max,           &&add_immediate,
+      &&subtract_immediate,          &&multiply_immediate,           &&divide_immediate,
+      &&residual_immediate,          &&min_immediate, &&max_immediate, &&return_value};
+  static_assert(std::size(kHandlers) == static_cast<size_t>(RegisterOp::kReturn) + 1);
+
+  const auto* ip = program.code.data();
+  goto *kHandlers[static_cast<uint8_t>(ip->op)];
+
+load:
+  r[ip->target] = ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+negate:
+  r[ip->target] = -r[ip->left];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+square:
+  r[ip->target] = r[ip->left] * r[ip->left];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+abs:
+  r[ip->target] = r[ip->left] < 0 ? -r[ip->left] : r[ip->left];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+add:
+  r[ip->target] = r[ip->left] + r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+subtract:
+  r[ip->target] = r[ip->left] - r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+multiply:
+  r[ip->target] = r[ip->left] * r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+divide:
+  r[ip->target] = r[ip->left] / r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+residual:
+  r[ip->target] = r[ip->left] % r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+min:
+  r[ip->target] = r[ip->left] < r[ip->right] ? r[ip->left] : r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+max:
+  r[ip->target] = r[ip->left] > r[ip->right] ? r[ip->left] : r[ip->right];
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+add_immediate:
+  r[ip->target] = r[ip->left] + ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+subtract_immediate:
+  r[ip->target] = r[ip->left] - ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+multiply_immediate:
+  r[ip->target] = r[ip->left] * ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+divide_immediate:
+  r[ip->target] = r[ip->left] / ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+residual_immediate:
+  r[ip->target] = r[ip->left] % ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+min_immediate:
+  r[ip->target] = r[ip->left] < ip->right ? r[ip->left] : ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+max_immediate:
+  r[ip->target] = r[ip->left] > ip->right ? r[ip->left] : ip->right;
+  goto *kHandlers[static_cast<uint8_t>((++ip)->op)];
+return_value:
+  return r[ip->left];
+}
+
+#pragma GCC diagnostic pop
+#else
+int ExecuteThreaded(const RegisterProgram& program, int* r) {
+  return ExecuteSwitch(program, r);
+}
+#endif
+
+}  // namespace
+
+void Compile(const Program& program, RegisterProgram& registers) {
+  if (program.code.empty()) {
+    throw std::invalid_argument("Compile: empty program");
+  }
+  thread_local std::vector<StackSlot> stack;
+  stack.clear();
+  registers.code.clear();
+  registers.registers = 0;
+  // Число из ячейки загружается в ее регистр; непосредственные операнды регистров не занимают
+  const auto materialize = [&registers](size_t slot) {
+    if (stack[slot].immediate) {
+      registers.code.push_back({RegisterOp::kLoad, static_cast<uint32_t>(slot), 0, stack[slot].value});
+      stack[slot].immediate = false;
+      registers.registers = slot < registers.registers ? registers.registers : slot + 1;
+    }
+  };
+
+  for (const auto& instruction : program.code) {
+    switch (instruction.op) {
+      case OpCode::kPush:
+        stack.push_back({true, instruction.value});
+        break;
+      case OpCode::kNegate:
+      case OpCode::kSquare:
+      case OpCode::kAbs: {
+        const auto slot = stack.size() - 1;
+        materialize(slot);
+        const auto reg = static_cast<uint32_t>(slot);
+        registers.code.push_back({RegisterOpOf(instruction.op, false), reg, reg, 0});
+        break;
+      }
+      case OpCode::kAdd:
+      case OpCode::kSubtract:
+      case OpCode::kMultiply:
+      case OpCode::kDivide:
+      case OpCode::kResidual:
+      case OpCode::kMin:
+      case OpCode::kMax: {  // бинарная операция: результат в регистре левого аргумента
+        const auto right = stack.size() - 1;
+        const auto left = right - 1;
+        materialize(left);
+        const auto reg = static_cast<uint32_t>(left);
+        if (stack[right].immediate) {
+          registers.code.push_back({RegisterOpOf(instruction.op, true), reg, reg, stack[right].value});
+        } else {
+          registers.code.push_back({RegisterOpOf(instruction.op, false), reg, reg, static_cast<int32_t>(right)});
+        }
+        stack.pop_back();
+        break;
+      }
+    }
+  }
+  materialize(0);
+  registers.code.push_back({RegisterOp::kReturn, 0, 0, 0});
+}
+
+int Execute(const RegisterProgram& program, Dispatch dispatch) {
+  if (program.code.empty()) {
+    throw std::invalid_argument("Execute: empty program");
+  }
+  thread_local std::vector<int> frame;  // память кадра переиспользуется между вызовами
+  if (frame.size() < program.registers) {
+    frame.resize(program.registers);
+  }
+  return dispatch == Dispatch::kThreaded ? ExecuteThreaded(program, frame.data())
+                                         : ExecuteSwitch(program, frame.data());
+}
+
+std::unique_ptr<IExpression> MakeUnaryNode(TokenKind kind, std::unique_ptr<IExpression> operand) {
+  switch (kind) {
+    case TokenKind::kMinus:
+      return std::make_unique<Minus>(std::move(operand));
+    case TokenKind::kSqr:
+      return std::make_unique<Square>(std::move(operand));
+    case TokenKind::kAbs:
+      return std::make_unique<AbsoluteValue>(std::move(operand));
+    case TokenKind::kPlus:
+      return std::make_unique<Plus>(std::move(operand));
+    case TokenKind::kMultiply:
+    case TokenKind::kDivide:
+    case TokenKind::kResidual:
+    case TokenKind::kMin:
+    case TokenKind::kMax:
+    case TokenKind::kOpeningBracket:
+    case TokenKind::kClosingBracket:
+    case TokenKind::kNumber:
+    case TokenKind::kUnknown:
+      break;
+  }
+  throw std::logic_error("MakeUnaryNode: not a unary operator");
+}
+
+std::unique_ptr<IExpression> MakeBinaryNode(TokenKind kind, std::unique_ptr<IExpression> left,
+                                            std::unique_ptr<IExpression> right) {
+  switch (kind) {
+    case TokenKind::kPlus:
+      return std::make_unique<Sum>(std::move(left), std::move(right));
+    case TokenKind::kMinus:
+      return std::make_unique<Subtract>(std::move(left), std::move(right));
+    case TokenKind::kMultiply:
+      return std::make_unique<Multiply>(std::move(left), std::move(right));
+    case TokenKind::kDivide:
+      return std::make_unique<Divide>(std::move(left), std::move(right));
+    case TokenKind::kResidual:
+      return std::make_unique<Residual>(std::move(left), std::move(right));
+    case TokenKind::kMin:
+      return std::make_unique<Minimum>(std::move(left), std::move(right));
+    case TokenKind::kMax:
+      return std::make_unique<Maximum>(std::move(left), std::move(right));
+    case TokenKind::kAbs:
+    case TokenKind::kSqr:
+    case TokenKind::kOpeningBracket:
+    case TokenKind::kClosingBracket:
+    case TokenKind::kNumber:
+    case TokenKind::kUnknown:
+      break;
+  }
+  throw std::logic_error("MakeBinaryNode: not a binary operator");
+}
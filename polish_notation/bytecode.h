@@ -0,0 +1,353 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_BYTECODE_H
+#define MY_BYTECODE_H
+
+#include "../tokenize/tokenize.h"
+#include "expressions.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Парсеры выдают выражение в постфиксном порядке (сначала аргументы, затем операция) в построитель:
+// TreeBuilder собирает из этого дерево IExpression, ProgramBuilder — плоскую программу для
+// стековой машины, которую выполняет Execute без построения дерева, а ValueBuilder сразу вычисляет
+// значение
+
+enum class OpCode : uint8_t {
+  kPush,  // положить на стек непосредственное значение
+  kNegate,
+  kSquare,
+  kAbs,
+  kAdd,
+  kSubtract,
+  kMultiply,
+  kDivide,
+  kResidual,
+  kMin,
+  kMax
+};
+
+struct Instruction {
+  OpCode op;
+  int32_t value;  // непосредственное значение kPush
+};
+
+static_assert(sizeof(Instruction) == 8);
+
+struct Program {
+  std::vector<Instruction> code;  // постфиксная запись выражения
+  size_t max_depth = 0;           // наибольшая глубина стека при выполнении
+};
+
+// Значение программы; вычисляет то же, что Calculate() у дерева, из которого она получена.
+// У пустой программы значения нет: бросается std::invalid_argument
+int Execute(const Program& program);
+
+// Перевод готового дерева в программу для многократного вычисления: Execute обходится без
+// виртуальных вызовов и переходов по указателям. Обход не рекурсивен. Узлы, не объявленные в
+// expressions.h, не поддерживаются: бросается std::invalid_argument
+void Compile(const IExpression& expression, Program& program);
+
+// Регистровая форма программы: трехадресные инструкции над кадром регистров. Регистр — это ячейка
+// стека Program, а число, которое Program кладет на стек прямо перед бинарной операцией, становится ее
+// непосредственным операндом, поэтому инструкций и переходов между ними меньше
+enum class RegisterOp : uint8_t {
+  kLoad,  // target = value
+  kNegate,  // target = op(left)
+  kSquare,
+  kAbs,
+  kAdd,  // target = left op right, где right — регистр
+  kSubtract,
+  kMultiply,
+  kDivide,
+  kResidual,
+  kMin,
+  kMax,
+  kAddImmediate,  // target = left op value
+  kSubtractImmediate,
+  kMultiplyImmediate,
+  kDivideImmediate,
+  kResidualImmediate,
+  kMinImmediate,
+  kMaxImmediate,
+  kReturn  // значение программы — регистр left
+};
+
+struct RegisterInstruction {
+  RegisterOp op;
+  uint32_t target;
+  uint32_t left;
+  int32_t right;  // номер регистра правого аргумента или непосредственное значение
+};
+
+static_assert(sizeof(RegisterInstruction) == 16);
+
+struct RegisterProgram {
+  std::vector<RegisterInstruction> code;  // заканчивается kReturn
+  size_t registers = 0;                   // размер кадра регистров
+};
+
+// Перевод стековой программы в регистровую; registers перезаписывается. Пустая программа
+// отвергается std::invalid_argument, как и в Execute
+void Compile(const Program& program, RegisterProgram& registers);
+
+// Способ выбора следующей инструкции: kSwitch — общий switch в цикле, kThreaded — переход по таблице
+// адресов меток в конце каждого обработчика (computed goto), так что у каждой операции свой косвенный
+// переход и предсказатель учится на парах операций. Без поддержки компилятором (GCC, Clang)
+// kThreaded выполняется как kSwitch. Результат не зависит от способа
+enum class Dispatch { kSwitch, kThreaded };
+
+// Пустая программа (без kReturn) отвергается std::invalid_argument
+int Execute(const RegisterProgram& program, Dispatch dispatch = Dispatch::kThreaded);
+
+// Операция из kind: унарная (-, +, sqr, abs) или бинарная (+, -, *, /, %, min, max)
+std::unique_ptr<IExpression> MakeUnaryNode(TokenKind kind, std::unique_ptr<IExpression> operand);
+
+std::unique_ptr<IExpression> MakeBinaryNode(TokenKind kind, std::unique_ptr<IExpression> left,
+                                            std::unique_ptr<IExpression> right);
+
+class TreeBuilder {  // узлы копятся в стеке вызывающего, чтобы его память переиспользовалась
+  std::vector<std::unique_ptr<IExpression>>& stack_;
+
+ public:
+  explicit TreeBuilder(std::vector<std::unique_ptr<IExpression>>& stack) : stack_(stack) {
+  }
+
+  TreeBuilder(const TreeBuilder&) = delete;
+  TreeBuilder& operator=(const TreeBuilder&) = delete;
+
+  ~TreeBuilder() {  // после ошибки разбора недостроенные поддеревья уничтожаются сразу, пока жива их арена
+    stack_.clear();
+  }
+
+  void Number(int32_t value) {
+    stack_.push_back(std::make_unique<Constant>(value));
+  }
+
+  void Unary(TokenKind kind) {
+    stack_.back() = MakeUnaryNode(kind, std::move(stack_.back()));
+  }
+
+  void Binary(TokenKind kind) {
+    auto right = std::move(stack_.back());
+    stack_.pop_back();
+    stack_.back() = MakeBinaryNode(kind, std::move(stack_.back()), std::move(right));
+  }
+
+  std::unique_ptr<IExpression> Result() {
+    auto result = std::move(stack_.back());
+    stack_.pop_back();
+    return result;
+  }
+};
+
+class ProgramBuilder {  // дописывает инструкции в program, считая глубину стека
+  Program& program_;
+  size_t depth_ = 0;
+
+ public:
+  explicit ProgramBuilder(Program& program) : program_(program) {
+    program_.code.clear();
+    program_.max_depth = 0;
+  }
+
+  void Number(int32_t value) {
+    program_.code.push_back({OpCode::kPush, value});
+    if (++depth_ > program_.max_depth) {
+      program_.max_depth = depth_;
+    }
+  }
+
+  void Unary(TokenKind kind) {
+    switch (kind) {
+      case TokenKind::kMinus:
+        program_.code.push_back({OpCode::kNegate, 0});
+        return;
+      case TokenKind::kSqr:
+        program_.code.push_back({OpCode::kSquare, 0});
+        return;
+      case TokenKind::kAbs:
+        program_.code.push_back({OpCode::kAbs, 0});
+        return;
+      case TokenKind::kPlus:  // унарный плюс не меняет значение
+        return;
+      case TokenKind::kMultiply:
+      case TokenKind::kDivide:
+      case TokenKind::kResidual:
+      case TokenKind::kMin:
+      case TokenKind::kMax:
+      case TokenKind::kOpeningBracket:
+      case TokenKind::kClosingBracket:
+      case TokenKind::kNumber:
+      case TokenKind::kUnknown:
+        break;
+    }
+    throw std::logic_error("ProgramBuilder: not a unary operator");
+  }
+
+  void Binary(TokenKind kind) {
+    --depth_;
+    switch (kind) {
+      case TokenKind::kPlus:
+        program_.code.push_back({OpCode::kAdd, 0});
+        return;
+      case TokenKind::kMinus:
+        program_.code.push_back({OpCode::kSubtract, 0});
+        return;
+      case TokenKind::kMultiply:
+        program_.code.push_back({OpCode::kMultiply, 0});
+        return;
+      case TokenKind::kDivide:
+        program_.code.push_back({OpCode::kDivide, 0});
+        return;
+      case TokenKind::kResidual:
+        program_.code.push_back({OpCode::kResidual, 0});
+        return;
+      case TokenKind::kMin:
+        program_.code.push_back({OpCode::kMin, 0});
+        return;
+      case TokenKind::kMax:
+        program_.code.push_back({OpCode::kMax, 0});
+        return;
+      case TokenKind::kAbs:
+      case TokenKind::kSqr:
+      case TokenKind::kOpeningBracket:
+      case TokenKind::kClosingBracket:
+      case TokenKind::kNumber:
+      case TokenKind::kUnknown:
+        break;
+    }
+    throw std::logic_error("ProgramBuilder: not a binary operator");
+  }
+
+  void Result() {  // программа уже записана в program
+  }
+};
+
+// Значение, вычисленное по ходу разбора. Деление на ноль (и INT_MIN / -1) при этом не выполняется
+// сразу, а запоминается: если дальше во входе синтаксическая ошибка или лишние токены, наружу
+// выходит она, как и у пути «разобрать, затем вычислить».
+//
+// Get выполняет первое такое деление намеренно, через Divide::Apply или Residual::Apply, то есть
+// так же, как Calculate() дерева. Это неопределенное поведение (на x86-64 — SIGFPE, UBSan сообщает
+// об ошибке), и оно сохранено специально, чтобы результат совпадал с прежним вычислением через
+// дерево. Тесты Get для такого значения не вызывают
+class DeferredValue {
+  int value_ = 0;
+  bool trapped_ = false;
+  TokenKind trap_kind_ = TokenKind::kDivide;
+  int trap_left_ = 0;
+  int trap_right_ = 0;
+
+  friend class ValueBuilder;
+
+ public:
+  int Get() const {
+    if (trapped_) {
+      volatile int right = trap_right_;  // volatile не дает компилятору выбросить деление
+      return trap_kind_ == TokenKind::kDivide ? Divide::Apply(trap_left_, right) : Residual::Apply(trap_left_, right);
+    }
+    return value_;
+  }
+};
+
+class ValueBuilder {  // вычисляет выражение на стеке значений вызывающего
+  std::vector<int>& stack_;
+  DeferredValue result_;
+
+ public:
+  explicit ValueBuilder(std::vector<int>& stack) : stack_(stack) {
+    stack_.clear();
+  }
+
+  void Number(int32_t value) {
+    stack_.push_back(value);
+  }
+
+  void Unary(TokenKind kind) {
+    auto& x = stack_.back();
+    switch (kind) {
+      case TokenKind::kMinus:
+        x = -x;
+        return;
+      case TokenKind::kSqr:
+        x = x * x;
+        return;
+      case TokenKind::kAbs:
+        x = x < 0 ? -x : x;
+        return;
+      case TokenKind::kPlus:  // унарный плюс не меняет значение
+        return;
+      case TokenKind::kMultiply:
+      case TokenKind::kDivide:
+      case TokenKind::kResidual:
+      case TokenKind::kMin:
+      case TokenKind::kMax:
+      case TokenKind::kOpeningBracket:
+      case TokenKind::kClosingBracket:
+      case TokenKind::kNumber:
+      case TokenKind::kUnknown:
+        break;
+    }
+    throw std::logic_error("ValueBuilder: not a unary operator");
+  }
+
+  void Binary(TokenKind kind) {
+    const auto y = stack_.back();
+    stack_.pop_back();
+    auto& x = stack_.back();
+    switch (kind) {
+      case TokenKind::kPlus:
+        x = x + y;
+        return;
+      case TokenKind::kMinus:
+        x = x - y;
+        return;
+      case TokenKind::kMultiply:
+        x = x * y;
+        return;
+      case TokenKind::kDivide:
+      case TokenKind::kResidual:
+        if (y == 0 || (x == std::numeric_limits<int>::min() && y == -1)) {
+          if (!result_.trapped_) {
+            result_.trapped_ = true;
+            result_.trap_kind_ = kind;
+            result_.trap_left_ = x;
+            result_.trap_right_ = y;
+          }
+          x = 0;
+        } else {
+          x = kind == TokenKind::kDivide ? x / y : x % y;
+        }
+        return;
+      case TokenKind::kMin:
+        x = x < y ? x : y;
+        return;
+      case TokenKind::kMax:
+        x = x > y ? x : y;
+        return;
+      case TokenKind::kAbs:
+      case TokenKind::kSqr:
+      case TokenKind::kOpeningBracket:
+      case TokenKind::kClosingBracket:
+      case TokenKind::kNumber:
+      case TokenKind::kUnknown:
+        break;
+    }
+    throw std::logic_error("ValueBuilder: not a binary operator");
+  }
+
+  DeferredValue Result() {
+    result_.value_ = stack_.back();
+    stack_.pop_back();
+    return result_;
+  }
+};
+
+#endif  // MY_BYTECODE_H
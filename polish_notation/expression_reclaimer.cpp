@@ -0,0 +1,44 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../polish_notation/expression_reclaimer.h"
+
+ExpressionReclaimer::ExpressionReclaimer() : worker_([this] { Run(); }) {
+}
+
+ExpressionReclaimer::~ExpressionReclaimer() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_one();
+  worker_.join();
+}
+
+void ExpressionReclaimer::Run() {
+  std::vector<std::unique_ptr<IExpression>> batch;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    batch.swap(queue_);
+    lock.unlock();
+    batch.clear();  // уничтожение без блокировки очереди
+    lock.lock();
+  }
+}
+
+void ExpressionReclaimer::Retire(std::unique_ptr<IExpression> expression) {
+  if (!expression || expression->in_arena_) {
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    queue_.push_back(std::move(expression));
+  }
+  ready_.notify_one();
+}
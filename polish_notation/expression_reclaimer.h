@@ -0,0 +1,39 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_EXPRESSION_RECLAIMER_H
+#define MY_EXPRESSION_RECLAIMER_H
+
+#include "expressions.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Фоновый поток, уничтожающий деревья вместо потока-обработчика, чтобы освобождение памяти
+// не входило во время ответа. Деревья из арены уничтожаются сразу в вызывающем потоке:
+// их память принадлежит арене, которая может быть сброшена раньше, чем до них дойдет очередь
+class ExpressionReclaimer {
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::vector<std::unique_ptr<IExpression>> queue_;
+  bool stopping_ = false;
+  std::thread worker_;  // запускается последним, когда остальные поля уже созданы
+
+  void Run();
+
+ public:
+  ExpressionReclaimer();
+
+  ExpressionReclaimer(const ExpressionReclaimer&) = delete;
+  ExpressionReclaimer& operator=(const ExpressionReclaimer&) = delete;
+
+  ~ExpressionReclaimer();  // дожидается уничтожения всех переданных деревьев
+
+  void Retire(std::unique_ptr<IExpression> expression);
+};
+
+#endif  // MY_EXPRESSION_RECLAIMER_H
@@ -6,13 +6,134 @@
 #ifndef MY_EXPRESSIONS_H  // объявление классов операций
 #define MY_EXPRESSIONS_H
 
+#include <cstddef>
 #include <memory>
+#include <new>
+#include <vector>
+
+// Арена для узлов выражений. Пока в потоке действует ExpressionArena::Scope, все узлы IExpression
+// (в том числе созданные через std::make_unique) берутся из арены сдвигом указателя: дерево лежит
+// в памяти подряд, а освобождение узла не обращается к malloc. Reset отдает всю память арены разом,
+// оставляя блоки для следующего выражения, поэтому после прогрева разбор не выделяет память вовсе.
+// Узлы из арены должны быть уничтожены до Reset или разрушения арены; уничтожать их можно и вне Scope
+class ExpressionArena {
+  static constexpr size_t kAlignment = alignof(std::max_align_t);
+  static constexpr size_t kFirstBlockSize = 4096;
+
+  struct Block {
+    std::unique_ptr<std::byte[]> memory;
+    size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  size_t block_ = 0;  // текущий блок
+  size_t used_ = 0;   // занятая часть текущего блока
+
+  static inline thread_local ExpressionArena* current = nullptr;
+
+ public:
+  ExpressionArena() = default;
+  ExpressionArena(const ExpressionArena&) = delete;
+  ExpressionArena& operator=(const ExpressionArena&) = delete;
+
+  void* Allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    while (block_ < blocks_.size() && used_ + size > blocks_[block_].size) {
+      ++block_;
+      used_ = 0;
+    }
+    if (block_ == blocks_.size()) {  // новый блок вдвое больше предыдущего
+      auto block_size = blocks_.empty() ? kFirstBlockSize : 2 * blocks_.back().size;
+      block_size = block_size < size ? size : block_size;
+      blocks_.push_back({std::make_unique<std::byte[]>(block_size), block_size});
+    }
+    auto* memory = blocks_[block_].memory.get() + used_;
+    used_ += size;
+    return memory;
+  }
+
+  void Reset() {
+    block_ = 0;
+    used_ = 0;
+  }
+
+  static ExpressionArena* Current() {
+    return current;
+  }
+
+  class Scope {  // делает арену текущей для потока до конца области видимости
+    ExpressionArena* previous_;
+
+   public:
+    explicit Scope(ExpressionArena& arena) : previous_(current) {
+      current = &arena;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    ~Scope() {
+      current = previous_;
+    }
+  };
+};
 
 class IExpression {  // абстрактный базовый класс для всех выражений
+  bool in_arena_ = ExpressionArena::Current() != nullptr;  // узел создан внутри ExpressionArena::Scope
+
+  // Очередь потока. При завершении потока или программы деревья из других thread_local и static
+  // объектов могут уничтожаться уже после нее; тогда используется очередь на стеке вызова
+  struct Worklist {
+    std::vector<IExpression*> nodes;
+    static inline thread_local bool destroyed = false;
+
+    ~Worklist() {
+      destroyed = true;
+    }
+  };
+
  public:
   virtual int Calculate() const = 0;  // чисто виртуальная функция для вычисления значения выражения
 
   virtual ~IExpression() = default;
+
+  static void* operator new(size_t size) {
+    if (auto* arena = ExpressionArena::Current()) {
+      return arena->Allocate(size);
+    }
+    return ::operator new(size);
+  }
+
+  // Уничтожающий operator delete: откуда взят узел, известно только до вызова деструктора.
+  // Он же разворачивает рекурсию: дочерние узлы, удаляемые деструктором родителя, не уничтожаются
+  // сразу, а попадают в очередь самого внешнего вызова, который их и разбирает. Поэтому сколь угодно
+  // глубокое дерево уничтожается на ограниченном стеке
+  void operator delete(IExpression* expression, std::destroying_delete_t) {
+    thread_local std::vector<IExpression*>* active = nullptr;  // очередь идущего уничтожения
+    if (active != nullptr) {
+      active->push_back(expression);
+      return;
+    }
+    std::vector<IExpression*> fallback;
+    active = &fallback;
+    if (!Worklist::destroyed) {  // память очереди потока переиспользуется между деревьями
+      thread_local Worklist worklist;
+      active = &worklist.nodes;
+    }
+    active->push_back(expression);
+    while (!active->empty()) {
+      auto* node = active->back();
+      active->pop_back();
+      const auto in_arena = node->in_arena_;
+      node->~IExpression();
+      if (!in_arena) {
+        ::operator delete(node);
+      }
+    }
+    active = nullptr;
+  }
+
+  friend class ExpressionReclaimer;
 };
 
 class Constant final : public IExpression {  // класс для представления константных значений.
@@ -25,6 +146,10 @@ class Constant final : public IExpression {  // класс для предста
   int Calculate() const final {
     return value_;
   }
+
+  int Value() const {
+    return value_;
+  }
 };
 
 class IUnaryOperation
@@ -41,42 +166,62 @@ class IUnaryOperation
   }
 
   virtual int Operation(int x) const = 0;  // чисто виртуальная функция для выполнения операции
+
+  const IExpression& Operand() const {
+    return *operand_;
+  }
 };
 
 class Square final : public IUnaryOperation {
  public:
   using IUnaryOperation::IUnaryOperation;  // перенос конструктора
 
-  int Operation(int x) const final {
+  static int Apply(int x) {  // сама операция, без узла и виртуального вызова (variant_expression.h)
     return x * x;
   }
+
+  int Operation(int x) const final {
+    return Apply(x);
+  }
 };
 
 class AbsoluteValue final : public IUnaryOperation {  // возвращает абсолютное значение
  public:
   using IUnaryOperation::IUnaryOperation; // перенос конструктора
 
-  int Operation(int x) const final {
+  static int Apply(int x) {
     return x < 0 ? -x : x;
   }
+
+  int Operation(int x) const final {
+    return Apply(x);
+  }
 };
 
 class Minus final : public IUnaryOperation {
  public:
   using IUnaryOperation::IUnaryOperation; // перенос конструктора
 
-  int Operation(int x) const final {
+  static int Apply(int x) {
     return -x;
   }
+
+  int Operation(int x) const final {
+    return Apply(x);
+  }
 };
 
 class Plus final : public IUnaryOperation {
  public:
   using IUnaryOperation::IUnaryOperation; // перенос конструктора
 
-  int Operation(int x) const final {
+  static int Apply(int x) {
     return x;
   }
+
+  int Operation(int x) const final {
+    return Apply(x);
+  }
 };
 
 class IBinaryOperation
@@ -96,69 +241,105 @@ class IBinaryOperation
   }
 
   virtual int Operation(int x, int y) const = 0;  // чисто виртуальная функция для выполнения операции
+
+  const IExpression& Left() const {
+    return *left_;
+  }
+
+  const IExpression& Right() const {
+    return *right_;
+  }
 };
 
 class Multiply final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {  // сама операция, без узла и виртуального вызова (variant_expression.h)
     return x * y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Sum final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x + y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Subtract final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x - y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Divide final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x / y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Residual final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x % y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Maximum final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x > y ? x : y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 class Minimum final : public IBinaryOperation {
  public:
   using IBinaryOperation::IBinaryOperation;
 
-  int Operation(int x, int y) const final {
+  static int Apply(int x, int y) {
     return x < y ? x : y;
   }
+
+  int Operation(int x, int y) const final {
+    return Apply(x, y);
+  }
 };
 
 #endif  // MY_EXPRESSIONS_H
\ No newline at end of file
@@ -0,0 +1,111 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../polish_notation/flat_expression.h"
+#include <stdexcept>
+
+FlatExpression::FlatExpression(const Program& program) {
+  Build(program);
+}
+
+FlatExpression::FlatExpression(const IExpression& expression) {
+  thread_local Program program;  // постфиксная запись дерева — это и есть порядок узлов
+  Compile(expression, program);
+  Build(program);
+}
+
+void FlatExpression::Build(const Program& program) {
+  if (program.code.empty()) {  // Calculate читает значение корня
+    throw std::invalid_argument("FlatExpression: empty program");
+  }
+  thread_local std::vector<uint32_t> roots;  // номера узлов на стеке программы
+  roots.clear();
+  opcodes_.reserve(program.code.size());
+  left_.reserve(program.code.size());
+  for (const auto& instruction : program.code) {
+    const auto index = static_cast<uint32_t>(opcodes_.size());
+    uint32_t left = 0;
+    switch (instruction.op) {
+      case OpCode::kPush:
+        literals_.push_back(instruction.value);
+        roots.push_back(index);
+        max_depth_ = roots.size() > max_depth_ ? roots.size() : max_depth_;
+        break;
+      case OpCode::kNegate:
+      case OpCode::kSquare:
+      case OpCode::kAbs:
+        roots.back() = index;
+        break;
+      case OpCode::kAdd:  // бинарная операция: правый аргумент — предыдущий узел
+      case OpCode::kSubtract:
+      case OpCode::kMultiply:
+      case OpCode::kDivide:
+      case OpCode::kResidual:
+      case OpCode::kMin:
+      case OpCode::kMax:
+        roots.pop_back();
+        left = roots.back();
+        roots.back() = index;
+        break;
+    }
+    opcodes_.push_back(instruction.op);
+    left_.push_back(left);
+  }
+}
+
+int FlatExpression::Calculate() const {
+  thread_local std::vector<int> stack;  // стек значений; память переиспользуется между вызовами
+  if (stack.size() < max_depth_) {
+    stack.resize(max_depth_);
+  }
+  auto* value = stack.data();
+  size_t top = 0;  // число значений на стеке
+  const auto* literal = literals_.data();
+  for (const auto op : opcodes_) {
+    switch (op) {
+      case OpCode::kPush:
+        value[top++] = *literal++;
+        break;
+      case OpCode::kNegate:
+        value[top - 1] = Minus::Apply(value[top - 1]);
+        break;
+      case OpCode::kSquare:
+        value[top - 1] = Square::Apply(value[top - 1]);
+        break;
+      case OpCode::kAbs:
+        value[top - 1] = AbsoluteValue::Apply(value[top - 1]);
+        break;
+      case OpCode::kAdd:
+        --top;
+        value[top - 1] = Sum::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kSubtract:
+        --top;
+        value[top - 1] = Subtract::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kMultiply:
+        --top;
+        value[top - 1] = Multiply::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kDivide:
+        --top;
+        value[top - 1] = Divide::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kResidual:
+        --top;
+        value[top - 1] = Residual::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kMin:
+        --top;
+        value[top - 1] = Minimum::Apply(value[top - 1], value[top]);
+        break;
+      case OpCode::kMax:
+        --top;
+        value[top - 1] = Maximum::Apply(value[top - 1], value[top]);
+        break;
+    }
+  }
+  return value[0];
+}
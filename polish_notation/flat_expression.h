@@ -0,0 +1,63 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_FLAT_EXPRESSION_H
+#define MY_FLAT_EXPRESSION_H
+
+#include "bytecode.h"
+#include "expressions.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Плоское хранение дерева: массивы по узлам в обратном порядке обхода (дети раньше родителя) вместо
+// отдельных объектов с указателями. Правый аргумент бинарного узла и аргумент унарного — всегда
+// предыдущий узел, поэтому хранится только 32-битный номер левого аргумента, а значения констант
+// лежат в отдельном массиве по порядку. Узел занимает 5 байт (и еще 4 у константы) против 32–48
+// байт узла IExpression с заголовком кучи. Calculate — один проход вперед по массивам со стеком
+// значений глубиной в высоту дерева, а не в число узлов
+class FlatExpression {
+  std::vector<OpCode> opcodes_;    // операция узла; kPush — константа
+  std::vector<uint32_t> left_;     // номер левого аргумента бинарного узла, у остальных 0
+  std::vector<int32_t> literals_;  // значения констант в порядке их узлов
+  size_t max_depth_ = 0;           // наибольшая глубина стека значений при вычислении
+
+  void Build(const Program& program);
+
+ public:
+  explicit FlatExpression(const Program& program);  // пустая программа отвергается std::invalid_argument
+
+  // Узлы, не объявленные в expressions.h, не поддерживаются: бросается std::invalid_argument.
+  // Унарный плюс не меняет значение и не хранится
+  explicit FlatExpression(const IExpression& expression);
+
+  int Calculate() const;
+
+  size_t Size() const {
+    return opcodes_.size();
+  }
+
+  OpCode Operation(size_t node) const {
+    return opcodes_[node];
+  }
+
+  size_t Left(size_t node) const {  // только для бинарного узла
+    return left_[node];
+  }
+
+  size_t Right(size_t node) const {  // аргумент унарного или правый аргумент бинарного узла
+    return node - 1;
+  }
+
+  size_t MaxDepth() const {
+    return max_depth_;
+  }
+
+  size_t MemoryUsage() const {  // байт под массивы узлов
+    return opcodes_.size() * sizeof(OpCode) + left_.size() * sizeof(uint32_t) + literals_.size() * sizeof(int32_t);
+  }
+};
+
+#endif  // MY_FLAT_EXPRESSION_H
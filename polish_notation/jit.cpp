@@ -0,0 +1,305 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../polish_notation/jit.h"
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define POLISH_NOTATION_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef POLISH_NOTATION_JIT
+
+// Сборка машинного кода. Регистр программы r лежит в кадре по адресу [rdi + 4 * r] (rdi — первый
+// аргумент по System V ABI), вычисления идут в eax и ecx, результат возвращается в eax
+class Assembler {
+  std::vector<uint8_t> code_;
+  int64_t cached_ = -1;  // регистр программы, значение которого сейчас в eax
+
+  void Emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+  }
+
+  void Emit32(int32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, sizeof(value));
+    code_.insert(code_.end(), bytes, bytes + 4);
+  }
+
+  static int32_t Displacement(uint32_t reg) {
+    return static_cast<int32_t>(4 * reg);
+  }
+
+ public:
+  std::vector<uint8_t>& Code() {
+    return code_;
+  }
+
+  void LoadEax(uint32_t reg) {  // mov eax, [rdi + disp32]
+    if (cached_ != reg) {
+      Emit({0x8B, 0x87});
+      Emit32(Displacement(reg));
+    }
+  }
+
+  void StoreEax(uint32_t reg) {  // mov [rdi + disp32], eax
+    Emit({0x89, 0x87});
+    Emit32(Displacement(reg));
+    cached_ = reg;
+  }
+
+  void StoreImmediate(uint32_t reg, int32_t value) {  // mov dword [rdi + disp32], imm32
+    Emit({0xC7, 0x87});
+    Emit32(Displacement(reg));
+    Emit32(value);
+    if (cached_ == reg) {
+      cached_ = -1;
+    }
+  }
+
+  void LoadEcx(uint32_t reg) {  // mov ecx, [rdi + disp32]
+    Emit({0x8B, 0x8F});
+    Emit32(Displacement(reg));
+  }
+
+  void LoadEcxImmediate(int32_t value) {  // mov ecx, imm32
+    Emit({0xB9});
+    Emit32(value);
+  }
+
+  void Negate() {  // neg eax
+    Emit({0xF7, 0xD8});
+  }
+
+  void Square() {  // imul eax, eax
+    Emit({0x0F, 0xAF, 0xC0});
+  }
+
+  void Abs() {  // mov ecx, eax; neg eax; cmovs eax, ecx
+    Emit({0x89, 0xC1, 0xF7, 0xD8, 0x0F, 0x48, 0xC1});
+  }
+
+  void AddEcx() {  // add eax, ecx
+    Emit({0x01, 0xC8});
+  }
+
+  void SubtractEcx() {  // sub eax, ecx
+    Emit({0x29, 0xC8});
+  }
+
+  void MultiplyEcx() {  // imul eax, ecx
+    Emit({0x0F, 0xAF, 0xC1});
+  }
+
+  void DivideEcx() {  // cdq; idiv ecx
+    Emit({0x99, 0xF7, 0xF9});
+  }
+
+  void ResidualEcx() {  // cdq; idiv ecx; mov eax, edx
+    Emit({0x99, 0xF7, 0xF9, 0x89, 0xD0});
+  }
+
+  void MinEcx() {  // cmp eax, ecx; cmovg eax, ecx
+    Emit({0x39, 0xC8, 0x0F, 0x4F, 0xC1});
+  }
+
+  void MaxEcx() {  // cmp eax, ecx; cmovl eax, ecx
+    Emit({0x39, 0xC8, 0x0F, 0x4C, 0xC1});
+  }
+
+  void AddImmediate(int32_t value) {  // add eax, imm32
+    Emit({0x05});
+    Emit32(value);
+  }
+
+  void SubtractImmediate(int32_t value) {  // sub eax, imm32
+    Emit({0x2D});
+    Emit32(value);
+  }
+
+  void MultiplyImmediate(int32_t value) {  // imul eax, eax, imm32
+    Emit({0x69, 0xC0});
+    Emit32(value);
+  }
+
+  void Return() {
+    Emit({0xC3});
+  }
+};
+
+// Правый аргумент бинарной операции загружается в ecx; сложение, вычитание и умножение на
+// непосредственное значение кодируются сразу с ним
+void EmitBinary(Assembler& assembler, const RegisterInstruction& instruction) {
+  assembler.LoadEax(instruction.left);
+  switch (instruction.op) {
+    case RegisterOp::kAddImmediate:
+      assembler.AddImmediate(instruction.right);
+      return;
+    case RegisterOp::kSubtractImmediate:
+      assembler.SubtractImmediate(instruction.right);
+      return;
+    case RegisterOp::kMultiplyImmediate:
+      assembler.MultiplyImmediate(instruction.right);
+      return;
+    case RegisterOp::kDivideImmediate:
+    case RegisterOp::kResidualImmediate:
+    case RegisterOp::kMinImmediate:
+    case RegisterOp::kMaxImmediate:
+      assembler.LoadEcxImmediate(instruction.right);
+      break;
+    case RegisterOp::kAdd:
+    case RegisterOp::kSubtract:
+    case RegisterOp::kMultiply:
+    case RegisterOp::kDivide:
+    case RegisterOp::kResidual:
+    case RegisterOp::kMin:
+    case RegisterOp::kMax:
+      assembler.LoadEcx(static_cast<uint32_t>(instruction.right));
+      break;
+    case RegisterOp::kLoad:
+    case RegisterOp::kNegate:
+    case RegisterOp::kSquare:
+    case RegisterOp::kAbs:
+    case RegisterOp::kReturn:
+      throw std::logic_error("EmitBinary: not a binary operation");
+  }
+  switch (instruction.op) {
+    case RegisterOp::kAdd:
+      assembler.AddEcx();
+      break;
+    case RegisterOp::kSubtract:
+      assembler.SubtractEcx();
+      break;
+    case RegisterOp::kMultiply:
+      assembler.MultiplyEcx();
+      break;
+    case RegisterOp::kDivide:
+    case RegisterOp::kDivideImmediate:
+      assembler.DivideEcx();
+      break;
+    case RegisterOp::kResidual:
+    case RegisterOp::kResidualImmediate:
+      assembler.ResidualEcx();
+      break;
+    case RegisterOp::kMin:
+    case RegisterOp::kMinImmediate:
+      assembler.MinEcx();
+      break;
+    case RegisterOp::kMax:
+    case RegisterOp::kMaxImmediate:
+      assembler.MaxEcx();
+      break;
+    case RegisterOp::kAddImmediate:  // уже выполнены выше
+    case RegisterOp::kSubtractImmediate:
+    case RegisterOp::kMultiplyImmediate:
+    case RegisterOp::kLoad:
+    case RegisterOp::kNegate:
+    case RegisterOp::kSquare:
+    case RegisterOp::kAbs:
+    case RegisterOp::kReturn:
+      break;
+  }
+}
+
+std::vector<uint8_t> Assemble(const RegisterProgram& program) {
+  Assembler assembler;
+  for (const auto& instruction : program.code) {
+    switch (instruction.op) {
+      case RegisterOp::kLoad:
+        assembler.StoreImmediate(instruction.target, instruction.right);
+        continue;
+      case RegisterOp::kNegate:
+        assembler.LoadEax(instruction.left);
+        assembler.Negate();
+        break;
+      case RegisterOp::kSquare:
+        assembler.LoadEax(instruction.left);
+        assembler.Square();
+        break;
+      case RegisterOp::kAbs:
+        assembler.LoadEax(instruction.left);
+        assembler.Abs();
+        break;
+      case RegisterOp::kReturn:
+        assembler.LoadEax(instruction.left);
+        assembler.Return();
+        continue;
+      case RegisterOp::kAdd:
+      case RegisterOp::kSubtract:
+      case RegisterOp::kMultiply:
+      case RegisterOp::kDivide:
+      case RegisterOp::kResidual:
+      case RegisterOp::kMin:
+      case RegisterOp::kMax:
+      case RegisterOp::kAddImmediate:
+      case RegisterOp::kSubtractImmediate:
+      case RegisterOp::kMultiplyImmediate:
+      case RegisterOp::kDivideImmediate:
+      case RegisterOp::kResidualImmediate:
+      case RegisterOp::kMinImmediate:
+      case RegisterOp::kMaxImmediate:
+        EmitBinary(assembler, instruction);
+        break;
+    }
+    assembler.StoreEax(instruction.target);
+  }
+  return std::move(assembler.Code());
+}
+
+#endif
+
+}  // namespace
+
+NativeProgram::NativeProgram(const Program& program) {
+  Compile(program, registers_);
+#ifdef POLISH_NOTATION_JIT
+  if (registers_.registers > INT32_MAX / 4) {  // смещение регистра не помещается в disp32
+    return;
+  }
+  const auto code = Assemble(registers_);
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const auto size = (code.size() + page - 1) / page * page;
+  auto* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return;
+  }
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {  // страница не бывает одновременно записываемой и исполняемой
+    munmap(memory, size);
+    return;
+  }
+  code_ = memory;
+  code_size_ = size;
+#endif
+}
+
+NativeProgram::~NativeProgram() {
+#ifdef POLISH_NOTATION_JIT
+  if (code_) {
+    munmap(code_, code_size_);
+  }
+#endif
+}
+
+int NativeProgram::Execute() const {
+#ifdef POLISH_NOTATION_JIT
+  if (code_) {
+    thread_local std::vector<int> frame;  // кадр регистров; память переиспользуется между вызовами
+    if (frame.size() < registers_.registers) {
+      frame.resize(registers_.registers);
+    }
+    return reinterpret_cast<int (*)(int*)>(code_)(frame.data());
+  }
+#endif
+  return ::Execute(registers_);
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_JIT_H
+#define MY_JIT_H
+
+#include "bytecode.h"
+#include <cstddef>
+
+// Выражение, переведенное в машинный код x86-64 для многократного вычисления. Код строится из
+// регистровой программы (bytecode.h) прямо в байты инструкций, без внешних библиотек, и лежит в
+// отдельной странице, отображенной через mmap (сначала на запись, затем только на выполнение).
+// На других архитектурах или если система не дала исполняемую память, Execute выполняет ту же
+// регистровую программу интерпретатором. Операции, включая деление и остаток от деления на ноль
+// (на x86-64 — то же аппаратное исключение idiv, что и в интерпретаторе), ведут себя так же, как Calculate() дерева.
+// Пустая программа отвергается std::invalid_argument (см. Compile)
+class NativeProgram {
+  RegisterProgram registers_;
+  void* code_ = nullptr;  // машинный код или nullptr, если используется интерпретатор
+  size_t code_size_ = 0;
+
+ public:
+  explicit NativeProgram(const Program& program);
+
+  NativeProgram(const NativeProgram&) = delete;
+  NativeProgram& operator=(const NativeProgram&) = delete;
+
+  ~NativeProgram();
+
+  bool IsNative() const {
+    return code_ != nullptr;
+  }
+
+  int Execute() const;
+};
+
+#endif  // MY_JIT_H
@@ -5,81 +5,123 @@
 
 #include "../tokenize/tokenize.h"
 #include "expressions.h"
+#include "bytecode.h"
 #include "../polish_notation/polish_notation.h"
 
-std::unique_ptr<IExpression> Parse(const std::vector<Token>& tokens, size_t& pos) {  // парс выр-ия польской нотации
-  if (pos >= tokens.size()) {  // проверка на недостаток аргументов
-    throw WrongExpressionError("too few arguments");
-  }
-  const auto& token = tokens[pos++];  // получаем текущий токен и увеличиваем позицию.
+namespace {
 
-  if (std::holds_alternative<UnknownToken>(token)) {  // если текущий токен — неизвестный, выбрасываем исключение
-    throw UnknownSymbolError("Unknown token: " + std::get<UnknownToken>(token).value);
-  }
+// Операция или скобка, ожидающая свои аргументы
+struct Frame {
+  CompactToken token;
+  bool has_first_arg;  // первый аргумент бинарной операции уже разобран и лежит у построителя
+};
 
-  if (std::holds_alternative<ClosingBracketToken>(token)) {  // обработка закрывающей скобки
-    throw WrongExpressionError("No matching (");
-  }
+// Разбор без рекурсии: вместо вызова на каждый аргумент операция кладется в стек кадров, а готовый
+// аргумент поднимается по стеку, пока не найдется кадр, которому нужен еще один аргумент. Аргументы и
+// операции уходят в builder в постфиксном порядке (bytecode.h), так что из того же разбора получается
+// дерево или программа. Стек кадров принадлежит потоку и переиспользуется
+template <class Tokens, class Builder>
+auto ParseImpl(Tokens& tokens, Builder& builder, size_t max_depth) {  // парс выр-ия польской нотации
+  thread_local std::vector<Frame> frames;
+  struct Cleanup {
+    ~Cleanup() {
+      frames.clear();
+    }
+  } cleanup;
 
-  if (std::holds_alternative<OpeningBracketToken>(token)) {  // обработка открывающейся скобки
-    auto sub_expression = Parse(tokens, pos);
-    if (pos >= tokens.size() || !std::holds_alternative<ClosingBracketToken>(tokens[pos++])) {
-      throw WrongExpressionError("No matching )");
+  while (true) {
+    if (tokens.Empty()) {  // проверка на недостаток аргументов
+      throw WrongExpressionError("too few arguments", tokens.Offset(), 0);
     }
-    return sub_expression;
-  }
+    const auto token = tokens.Next();  // получаем текущий токен и увеличиваем позицию.
 
-  if (std::holds_alternative<NumberToken>(token)) {
-    return std::make_unique<Constant>(std::get<NumberToken>(token).value);
-  }
+    switch (token.kind) {
+      case TokenKind::kUnknown:  // если текущий токен — неизвестный, выбрасываем исключение
+        throw UnknownSymbolError("Unknown token: " + std::string(tokens.Text(token)), token.offset, token.length);
+      case TokenKind::kClosingBracket:  // обработка закрывающей скобки
+        throw WrongExpressionError("No matching (", token.offset, token.length);
+      case TokenKind::kNumber:
+        break;
+      default:  // скобка или операция: ждем аргументы
+        if (frames.size() >= max_depth) {
+          throw WrongExpressionError("expression is too deep", token.offset, token.length);
+        }
+        frames.push_back({token, false});
+        continue;
+    }
 
-  auto first_arg = Parse(tokens, pos);  // обработка унарных операций
-  if (std::holds_alternative<SqrToken>(token)) {
-    return std::make_unique<Square>(std::move(first_arg));
-  }
-  if (std::holds_alternative<AbsToken>(token)) {
-    return std::make_unique<AbsoluteValue>(std::move(first_arg));
-  }
-  if (pos >= tokens.size() || std::holds_alternative<ClosingBracketToken>(tokens[pos])) {
-    if (std::holds_alternative<PlusToken>(token)) {
-      return std::make_unique<Plus>(std::move(first_arg));
+    builder.Number(token.value);
+    while (!frames.empty()) {  // поднимаем готовый аргумент по стеку кадров
+      auto& frame = frames.back();
+      const auto kind = frame.token.kind;
+      if (kind == TokenKind::kOpeningBracket) {  // обработка открывающейся скобки
+        if (tokens.Empty() || tokens.Next().kind != TokenKind::kClosingBracket) {
+          throw WrongExpressionError("No matching )", frame.token.offset, frame.token.length);
+        }
+      } else if (kind == TokenKind::kSqr || kind == TokenKind::kAbs) {  // обработка унарных операций
+        builder.Unary(kind);
+      } else if (frame.has_first_arg) {  // обработка бинарных операций
+        builder.Binary(kind);
+      } else if ((kind == TokenKind::kPlus || kind == TokenKind::kMinus) &&
+                 (tokens.Empty() || tokens.Peek().kind == TokenKind::kClosingBracket)) {
+        builder.Unary(kind);
+      } else {  // разобран первый аргумент, переходим ко второму
+        frame.has_first_arg = true;
+        break;
+      }
+      frames.pop_back();
     }
-    if (std::holds_alternative<MinusToken>(token)) {
-      return std::make_unique<Minus>(std::move(first_arg));
+    if (frames.empty()) {
+      return builder.Result();
     }
   }
+}
 
-  auto second_arg = Parse(tokens, pos);  // обработка бинарных операций
-  if (std::holds_alternative<PlusToken>(token)) {
-    return std::make_unique<Sum>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<MinusToken>(token)) {
-    return std::make_unique<Subtract>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<MultiplyToken>(token)) {
-    return std::make_unique<Multiply>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<DivideToken>(token)) {
-    return std::make_unique<Divide>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<ResidualToken>(token)) {
-    return std::make_unique<Residual>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<MinToken>(token)) {
-    return std::make_unique<Minimum>(std::move(first_arg), std::move(second_arg));
-  }
-  if (std::holds_alternative<MaxToken>(token)) {
-    return std::make_unique<Maximum>(std::move(first_arg), std::move(second_arg));
-  }
-  throw WrongExpressionError("Invalid token");
+thread_local std::vector<std::unique_ptr<IExpression>> operands;  // стек узлов для TreeBuilder
+thread_local std::vector<int> values;                            // стек значений для ValueBuilder
+
+}  // namespace
+
+std::unique_ptr<IExpression> Parse(const std::vector<Token>& tokens, size_t& pos, size_t max_depth) {
+  TokenCursor cursor(tokens, pos);
+  TreeBuilder builder(operands);
+  return ParseImpl(cursor, builder, max_depth);
+}
+
+std::unique_ptr<IExpression> Parse(TokenStream& tokens, size_t max_depth) {
+  TreeBuilder builder(operands);
+  return ParseImpl(tokens, builder, max_depth);
 }
 
-int CalculatePolishNotation(std::string_view input) {
-  const auto tokens = Tokenize(input);  // токенизируем, возвращая вектор токенов
-  size_t pos = 0;
-  const auto expression = Parse(tokens, pos);
-  if (pos < tokens.size()) {
-    throw WrongExpressionError("extra tokens detected");
+void Compile(const std::vector<Token>& tokens, size_t& pos, Program& program, size_t max_depth) {
+  TokenCursor cursor(tokens, pos);
+  ProgramBuilder builder(program);
+  ParseImpl(cursor, builder, max_depth);
+}
+
+void Compile(TokenStream& tokens, Program& program, size_t max_depth) {
+  ProgramBuilder builder(program);
+  ParseImpl(tokens, builder, max_depth);
+}
+
+DeferredValue Evaluate(TokenStream& tokens, size_t max_depth) {
+  ValueBuilder builder(values);
+  return ParseImpl(tokens, builder, max_depth);
+}
+
+int CalculatePolishNotation(std::string_view input) {  // выражение вычисляется один раз, поэтому прямо по ходу разбора
+  TokenStream tokens(input);  // токены читаются по мере разбора
+  try {
+    const auto value = Evaluate(tokens);
+    if (!tokens.Empty()) {
+      throw WrongExpressionError("extra tokens detected", tokens.Peek().offset, tokens.Peek().length);
+    }
+    return value.Get();
+  } catch (const UnknownSymbolError&) {  // недопустимый символ дальше по входу важнее ошибки разбора
+    tokens.ScanRest();
+    throw;
+  } catch (const WrongExpressionError&) {
+    tokens.ScanRest();
+    throw;
   }
-  return expression->Calculate();
 }
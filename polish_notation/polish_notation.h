@@ -6,22 +6,77 @@
 #ifndef MY_POLISH_NOTATION_H
 #define MY_POLISH_NOTATION_H
 
+#include <limits>
 #include <string>
 #include <string_view>
 #include <stdexcept>
+#include "../tokenize/tokenize.h"
+#include "expressions.h"
+#include "bytecode.h"
 
 class UnknownSymbolError : public std::runtime_error { // если неизвестный символ
+  size_t offset_ = 0;  // положение ошибочного фрагмента во входной строке
+  size_t length_ = 0;
+
  public:
   explicit UnknownSymbolError(const std::string& symbol = "") : std::runtime_error("UnknownSymbolError: " + symbol) {
   }
+
+  UnknownSymbolError(const std::string& symbol, size_t offset, size_t length)
+      : std::runtime_error("UnknownSymbolError: " + symbol), offset_(offset), length_(length) {
+  }
+
+  size_t Offset() const {
+    return offset_;
+  }
+
+  size_t Length() const {
+    return length_;
+  }
 };
 
 class WrongExpressionError : public std::runtime_error { // если неверная структура выражения
+  size_t offset_ = 0;  // положение ошибочного фрагмента во входной строке
+  size_t length_ = 0;
+
  public:
   explicit WrongExpressionError(const std::string& msg = "") : std::runtime_error("WrongExpressionError: " + msg) {
   }
+
+  WrongExpressionError(const std::string& msg, size_t offset, size_t length)
+      : std::runtime_error("WrongExpressionError: " + msg), offset_(offset), length_(length) {
+  }
+
+  size_t Offset() const {
+    return offset_;
+  }
+
+  size_t Length() const {
+    return length_;
+  }
 };
 
+// Предел вложенности операций и скобок по умолчанию для Parse. Разбор и уничтожение дерева не
+// рекурсивны, но Calculate() рекурсивен, поэтому слишком глубокое дерево отвергается с
+// WrongExpressionError. Compile и Evaluate дерева не строят и по умолчанию глубину не ограничивают
+inline constexpr size_t kMaxParseDepth = 10'000;
+
+inline constexpr size_t kUnlimitedDepth = std::numeric_limits<size_t>::max();
+
+std::unique_ptr<IExpression> Parse(const std::vector<Token>& tokens, size_t& pos, size_t max_depth = kMaxParseDepth);
+
+// разбор прямо из ленивого потока токенов
+std::unique_ptr<IExpression> Parse(TokenStream& tokens, size_t max_depth = kMaxParseDepth);
+
+// Разбор сразу в постфиксную программу (bytecode.h) без построения дерева; program перезаписывается
+void Compile(const std::vector<Token>& tokens, size_t& pos, Program& program, size_t max_depth = kUnlimitedDepth);
+
+void Compile(TokenStream& tokens, Program& program, size_t max_depth = kUnlimitedDepth);
+
+// Вычисление по ходу разбора без дерева и программы, с постоянным числом выделений памяти. Результат
+// (DeferredValue::Get) и ошибки те же, что у Parse с последующим Calculate()
+DeferredValue Evaluate(TokenStream& tokens, size_t max_depth = kUnlimitedDepth);
+
 int CalculatePolishNotation(std::string_view input);
 
 #endif  // MY_POLISH_NOTATION_H
@@ -0,0 +1,138 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "polish_notation.h"
+#include "flat_expression.h"
+#include "jit.h"
+#include "variant_expression.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+// Генерация случайного выражения польской нотации из terms чисел (глубина дерева — порядка логарифма)
+static void AppendExpression(size_t terms, std::mt19937& generator, std::string& input) {
+  static constexpr std::string_view kOperators[] = {"+ ", "- ", "* ", "max ", "min "};
+  if (terms == 1) {
+    input += std::to_string(1 + generator() % 1000) + ' ';
+    return;
+  }
+  input += kOperators[generator() % std::size(kOperators)];
+  const auto left = 1 + generator() % (terms - 1);
+  AppendExpression(left, generator, input);
+  AppendExpression(terms - left, generator, input);
+}
+
+static std::string GenerateExpression(size_t terms) {
+  std::mt19937 generator(42);
+  std::string input;
+  AppendExpression(terms, generator, input);
+  input.pop_back();
+  return input;
+}
+
+// Возвращает лучшее из нескольких измерений время одного вызова function в наносекундах
+template <class Function>
+static double Measure(size_t repeats, Function function) {
+  constexpr size_t kAttempts = 5;
+  double best = 1e300;
+  for (size_t attempt = 0; attempt < kAttempts; ++attempt) {
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < repeats; ++i) {
+      function();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / static_cast<double>(repeats));
+  }
+  return best;
+}
+
+int main() {
+  const auto long_input = GenerateExpression(100'000);
+  const auto tokens = Tokenize(long_input);
+  std::cout << "Parse, " << tokens.size() << " tokens: " << Measure(10, [&tokens] {
+    size_t pos = 0;
+    return Parse(tokens, pos);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  ExpressionArena arena;
+  std::cout << "Parse in ExpressionArena: " << Measure(10, [&tokens, &arena] {
+    arena.Reset();
+    ExpressionArena::Scope scope(arena);
+    size_t pos = 0;
+    (void)Parse(tokens, pos);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  Program program;
+  std::cout << "Compile, " << tokens.size() << " tokens: " << Measure(10, [&tokens, &program] {
+    size_t pos = 0;
+    Compile(tokens, pos, program);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  std::cout << "Compile + Execute, " << tokens.size() << " tokens: " << Measure(10, [&long_input, &program] {
+    TokenStream stream(long_input);
+    Compile(stream, program);
+    return Execute(program);
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  std::cout << "Evaluate, " << tokens.size() << " tokens: " << Measure(10, [&long_input] {
+    TokenStream stream(long_input);
+    return Evaluate(stream).Get();
+  }) / static_cast<double>(tokens.size()) << " ns/token\n";
+
+  // повторное вычисление готового выражения: обход дерева виртуальными вызовами и программа из него
+  size_t pos = 0;
+  const auto expression = Parse(tokens, pos);
+  std::cout << "Calculate (tree walk), " << tokens.size() << " nodes: " << Measure(10, [&expression] {
+    return expression->Calculate();
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+
+  const VariantExpression variant(*expression);
+  std::cout << "VariantExpression: " << Measure(10, [&variant] {
+    return variant.Calculate();
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+
+  Compile(*expression, program);
+  std::cout << "Execute (compiled tree): " << Measure(10, [&program] {
+    return Execute(program);
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+
+  RegisterProgram registers;
+  Compile(program, registers);
+  std::cout << "Registers: " << registers.code.size() << " instructions instead of " << program.code.size() << '\n';
+  std::cout << "Execute (registers, switch): " << Measure(10, [&registers] {
+    return Execute(registers, Dispatch::kSwitch);
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+  std::cout << "Execute (registers, threaded): " << Measure(10, [&registers] {
+    return Execute(registers, Dispatch::kThreaded);
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+
+  const NativeProgram native(program);
+  std::cout << "NativeProgram (" << (native.IsNative() ? "x86-64" : "interpreter") << "): " << Measure(10, [&native] {
+    return native.Execute();
+  }) / static_cast<double>(tokens.size()) << " ns/node\n";
+
+  // дерево из миллионов узлов: узлы IExpression в куче против плоских массивов
+  const auto huge_input = GenerateExpression(2'000'000);
+  TokenStream huge_tokens(huge_input);
+  const auto huge = Parse(huge_tokens);
+  const FlatExpression flat(*huge);
+  std::cout << "Tree, " << flat.Size() << " nodes: " << sizeof(Constant) << " bytes per Constant, " << sizeof(Sum)
+            << " per binary node, plus heap headers\n";
+  std::cout << "FlatExpression: " << static_cast<double>(flat.MemoryUsage()) / static_cast<double>(flat.Size())
+            << " bytes per node\n";
+  std::cout << "Calculate (tree walk): " << Measure(3, [&huge] {
+    return huge->Calculate();
+  }) / static_cast<double>(flat.Size()) << " ns/node\n";
+  std::cout << "FlatExpression::Calculate: " << Measure(3, [&flat] {
+    return flat.Calculate();
+  }) / static_cast<double>(flat.Size()) << " ns/node\n";
+
+  const auto short_input = GenerateExpression(8);
+  std::cout << "CalculatePolishNotation(\"" << short_input << "\"): " << Measure(100'000, [&short_input] {
+    return CalculatePolishNotation(short_input);
+  }) << " ns\n";
+  return 0;
+}
@@ -6,9 +6,14 @@
 
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
+#include <thread>
 #include <type_traits>
 #include "polish_notation.h"
 #include "expressions.h"
+#include "expression_reclaimer.h"
+#include "flat_expression.h"
+#include "jit.h"
+#include "variant_expression.h"
 
 using ExpressionPtr = std::unique_ptr<IExpression>;
 
@@ -423,3 +428,359 @@ TEST_CASE("WrongExpressionError", "[Exceptions]") {
   REQUIRE_THROWS_AS((void)CalculatePolishNotation("sqr sqr - 2 + 6 min 5 0 min max 2 3 sqr abs -3"),  // NOLINT
                     WrongExpressionError);
 }
+
+TEST_CASE("Stream", "[PolishNotation]") {
+  TokenStream tokens("* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100) 7");
+  const auto expression = Parse(tokens);
+
+  REQUIRE(expression->Calculate() == -16);
+  REQUIRE(tokens.Next().value == 7);
+  REQUIRE(tokens.Empty());
+}
+
+TEST_CASE("ErrorSpans", "[Exceptions]") {
+  const auto span_of = [](std::string_view input) -> std::pair<size_t, size_t> {
+    try {
+      (void)CalculatePolishNotation(input);
+    } catch (const UnknownSymbolError& error) {
+      return {error.Offset(), error.Length()};
+    } catch (const WrongExpressionError& error) {
+      return {error.Offset(), error.Length()};
+    }
+    return {std::string_view::npos, 0};
+  };
+  REQUIRE(span_of("+ 3 + 4 Square 6") == std::pair<size_t, size_t>{8, 6});
+  REQUIRE(span_of("+ 1 ( * 2 3") == std::pair<size_t, size_t>{4, 1});
+  REQUIRE(span_of("+ 1 2 ) 4") == std::pair<size_t, size_t>{6, 1});
+  REQUIRE(span_of("min max 1 2") == std::pair<size_t, size_t>{11, 0});
+  REQUIRE(span_of("abs 3 33") == std::pair<size_t, size_t>{6, 2});
+}
+
+TEST_CASE("ErrorPrecedence", "[Exceptions]") {  // недопустимый символ в любом месте входа важнее ошибки разбора
+  const auto position_of = [](std::string_view input) -> size_t {
+    try {
+      (void)CalculatePolishNotation(input);
+    } catch (const TokenizeError& error) {
+      return error.Position();
+    }
+    return std::string_view::npos;
+  };
+  REQUIRE(position_of("1 2 #") == 4);
+  REQUIRE(position_of("/absabs(3#)3") == 9);
+  REQUIRE(position_of("+ 1 2 3 #") == 8);
+  REQUIRE(position_of("+ # 1 #") == 2);
+  REQUIRE_THROWS_AS((void)CalculatePolishNotation("1 2 3"), WrongExpressionError);
+  REQUIRE_THROWS_AS((void)CalculatePolishNotation("/absabs(3)3"), UnknownSymbolError);
+}
+
+TEST_CASE("DepthLimit", "[PolishNotation]") {
+  const auto right_deep = [](size_t terms) {
+    std::string input;
+    for (size_t i = 1; i < terms; ++i) {
+      input += "+ 1 ";
+    }
+    return input + "1";
+  };
+
+  const auto input = right_deep(1'000'000);
+  TokenStream tokens(input);
+  try {
+    (void)Parse(tokens);
+    FAIL("depth limit is not enforced");
+  } catch (const WrongExpressionError& error) {
+    REQUIRE(error.Offset() == 4 * kMaxParseDepth);
+    REQUIRE(error.Length() == 1);
+  }
+
+  const auto deep_input = right_deep(2 * kMaxParseDepth);
+  TokenStream deep_tokens(deep_input);
+  REQUIRE(Parse(deep_tokens, 2 * kMaxParseDepth)->Calculate() == static_cast<int>(2 * kMaxParseDepth));
+  REQUIRE(CalculatePolishNotation(right_deep(kMaxParseDepth)) == static_cast<int>(kMaxParseDepth));
+
+  // CalculatePolishNotation дерева не строит, поэтому предел Parse к нему не относится
+  REQUIRE(CalculatePolishNotation(deep_input) == static_cast<int>(2 * kMaxParseDepth));
+  REQUIRE(CalculatePolishNotation(right_deep(50'000)) == 50'000);
+  REQUIRE(CalculatePolishNotation(std::string(kMaxParseDepth + 1, '-') + "1") == -1);
+  REQUIRE(CalculatePolishNotation(input) == 1'000'000);
+}
+
+TEST_CASE("Arena", "[ExpressionArena]") {
+  ExpressionArena arena;
+  for (int round = 0; round < 3; ++round) {
+    auto heap_node = std::make_unique<Constant>(4);
+    arena.Reset();
+    ExpressionArena::Scope scope(arena);
+    auto first = std::make_unique<Constant>(1);
+    auto second = std::make_unique<Constant>(2);
+    const auto distance =
+        reinterpret_cast<const std::byte*>(second.get()) - reinterpret_cast<const std::byte*>(first.get());
+    REQUIRE(distance > 0);
+    REQUIRE(distance <= 32);
+
+    TokenStream tokens("+ * 3 max 1 - 7 (-2) abs 5");
+    auto expression = Parse(tokens);
+    REQUIRE(expression->Calculate() == 32);
+
+    // узлы из арены и из кучи можно смешивать в одном дереве
+    auto mixed = std::make_unique<Sum>(std::move(first), std::make_unique<Minus>(std::move(heap_node)));
+    REQUIRE(mixed->Calculate() == -3);
+  }
+
+  // узел из арены можно уничтожить и после выхода из Scope
+  std::unique_ptr<IExpression> outlived;
+  {
+    ExpressionArena::Scope scope(arena);
+    outlived = std::make_unique<Square>(std::make_unique<Constant>(7));
+  }
+  REQUIRE(outlived->Calculate() == 49);
+  outlived.reset();
+  REQUIRE(ExpressionArena::Current() == nullptr);
+
+  REQUIRE_THROWS_AS((void)CalculatePolishNotation("+ 1 ( * 2 3"), WrongExpressionError);
+  REQUIRE(CalculatePolishNotation("* 6 7") == 42);
+}
+
+TEST_CASE("Bytecode", "[Program]") {
+  Program program;
+  for (const auto* input : {"7", "* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "- 5", "(+ 3)",
+                            "min max 1 2 - 10 % 37 7", "sqr abs - 4"}) {
+    TokenStream stream(input);
+    TokenStream reference(input);
+    Compile(stream, program);
+    REQUIRE(stream.Empty());
+    REQUIRE(Execute(program) == Parse(reference)->Calculate());
+  }
+
+  TokenStream tokens("+ 1 * 2 3");
+  Compile(tokens, program);
+  REQUIRE(program.code.size() == 5);
+  REQUIRE(program.code[0].op == OpCode::kPush);
+  REQUIRE(program.code[0].value == 1);
+  REQUIRE(program.code[3].op == OpCode::kMultiply);
+  REQUIRE(program.code[4].op == OpCode::kAdd);
+  REQUIRE(program.max_depth == 3);
+
+  TokenStream broken("+ 1 ( * 2 3");
+  REQUIRE_THROWS_AS(Compile(broken, program), WrongExpressionError);
+  REQUIRE_THROWS_AS(Execute(Program{}), std::invalid_argument);
+}
+
+TEST_CASE("Reclaimer", "[ExpressionReclaimer]") {
+  ExpressionReclaimer reclaimer;
+  for (int i = 0; i < 100; ++i) {
+    TokenStream tokens("* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)");
+    auto expression = Parse(tokens);
+    REQUIRE(expression->Calculate() == -16);
+    reclaimer.Retire(std::move(expression));
+    REQUIRE(expression == nullptr);
+  }
+  reclaimer.Retire(nullptr);
+
+  ExpressionArena arena;
+  ExpressionArena::Scope scope(arena);
+  reclaimer.Retire(std::make_unique<Minus>(std::make_unique<Constant>(1)));  // из арены — уничтожается сразу
+}
+
+TEST_CASE("ThreadExitTeardown", "[IExpression]") {
+  std::thread([] {
+    // дерево создано раньше очереди уничтожения потока, поэтому уничтожается уже после нее
+    thread_local ExpressionPtr tree;
+    tree = std::make_unique<Constant>(0);
+    for (int i = 0; i < 100'000; ++i) {
+      tree = std::make_unique<Minus>(std::move(tree));
+    }
+    (void)std::make_unique<Minus>(std::make_unique<Constant>(1));  // создает очередь потока
+  }).join();
+}
+
+TEST_CASE("Evaluate", "[PolishNotation]") {
+  for (const std::string_view input : {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "max 1 min 2 3",
+                                       "/ (-7) 2", "% (-7) 2", "sqr abs - 3 10"}) {
+    TokenStream tree_tokens(input);
+    TokenStream value_tokens(input);
+    REQUIRE(Evaluate(value_tokens).Get() == Parse(tree_tokens)->Calculate());
+    REQUIRE(value_tokens.Empty());
+  }
+
+  // деление на ноль сообщается только после проверки лишних токенов
+  TokenStream zero("/ 1 0");
+  REQUIRE_NOTHROW(Evaluate(zero));
+  REQUIRE(zero.Empty());
+  REQUIRE_THROWS_AS(CalculatePolishNotation("/ 1 0 )"), WrongExpressionError);
+
+  TokenStream broken("+ 1 ( * 2 3");
+  REQUIRE_THROWS_AS(Evaluate(broken), WrongExpressionError);
+  TokenStream unknown("+ 1 foo");
+  REQUIRE_THROWS_AS(Evaluate(unknown), UnknownSymbolError);
+  const std::string deep_input = std::string(100, '-') + "1";
+  TokenStream deep(deep_input);
+  REQUIRE_THROWS_AS(Evaluate(deep, 10), WrongExpressionError);
+}
+
+class Twice final : public IUnaryOperation {  // узел, о котором Compile не знает
+ public:
+  using IUnaryOperation::IUnaryOperation;
+
+  int Operation(int x) const final {
+    return 2 * x;
+  }
+};
+
+TEST_CASE("CompileTree", "[Program]") {
+  Program program;
+  for (const std::string_view input : {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "(+ 7)",
+                                       "max 1 min 2 3", "/ (-7) 2", "% (-7) 2", "sqr abs - 3 10", "42"}) {
+    TokenStream tokens(input);
+    const auto expression = Parse(tokens);
+    Compile(*expression, program);
+    REQUIRE(Execute(program) == expression->Calculate());
+  }
+
+  ExpressionPtr deep = std::make_unique<Constant>(1);
+  for (int i = 0; i < 100'000; ++i) {  // Calculate() на таком дереве переполнил бы стек
+    deep = std::make_unique<Sum>(std::move(deep), std::make_unique<Minus>(std::make_unique<Constant>(i % 3)));
+  }
+  Compile(*deep, program);
+  REQUIRE(program.max_depth == 2);
+  REQUIRE(Execute(program) == 1 - 99'999);
+
+  const Sum unsupported(std::make_unique<Constant>(1), std::make_unique<Twice>(std::make_unique<Constant>(2)));
+  REQUIRE_THROWS_AS(Compile(unsupported, program), std::invalid_argument);
+}
+
+TEST_CASE("RegisterProgram", "[RegisterProgram]") {
+  Program program;
+  RegisterProgram registers;
+  for (const std::string_view input : {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "(+ 7)",
+                                       "max 1 min 2 3", "/ (-7) 2", "% (-7) 2", "% 7 (-2)", "sqr abs - 3 10", "42",
+                                       "- 1 * 2 3", "min - 10 4 max sqr 3 abs (-20)"}) {
+    TokenStream tokens(input);
+    const auto expression = Parse(tokens);
+    Compile(*expression, program);
+    Compile(program, registers);
+    REQUIRE(Execute(registers, Dispatch::kSwitch) == expression->Calculate());
+    REQUIRE(Execute(registers, Dispatch::kThreaded) == expression->Calculate());
+  }
+
+  TokenStream tokens("+ 1 * 2 3");
+  Compile(tokens, program);
+  Compile(program, registers);  // r1 = 2; r1 = r1 * 3; r0 = 1; r0 = r0 + r1
+  REQUIRE(registers.code.size() == 5);
+  REQUIRE(registers.code[1].op == RegisterOp::kMultiplyImmediate);
+  REQUIRE(registers.code[1].right == 3);
+  REQUIRE(registers.code[2].op == RegisterOp::kLoad);
+  REQUIRE(registers.code[3].op == RegisterOp::kAdd);
+  REQUIRE(registers.code[4].op == RegisterOp::kReturn);
+  REQUIRE(registers.registers == 2);
+
+  ExpressionPtr deep = std::make_unique<Constant>(1);
+  for (int i = 0; i < 1'000; ++i) {  // глубокое правое дерево занимает много регистров
+    deep = std::make_unique<Subtract>(std::make_unique<Constant>(i), std::move(deep));
+  }
+  Compile(*deep, program);
+  Compile(program, registers);
+  REQUIRE(registers.registers == 1'000);  // самое глубокое число — непосредственный операнд
+  REQUIRE(Execute(registers, Dispatch::kSwitch) == deep->Calculate());
+  REQUIRE(Execute(registers) == deep->Calculate());
+
+  REQUIRE_THROWS_AS(Compile(Program{}, registers), std::invalid_argument);
+  REQUIRE_THROWS_AS(Execute(RegisterProgram{}), std::invalid_argument);
+}
+
+TEST_CASE("NativeProgram", "[NativeProgram]") {
+#if defined(__x86_64__) && defined(__unix__)
+  constexpr bool kExpectNative = true;
+#else
+  constexpr bool kExpectNative = false;
+#endif
+  Program program;
+  for (const std::string_view input :
+       {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "(+ 7)", "max 1 min 2 3", "/ (-7) 2",
+        "% (-7) 2", "% 7 (-2)", "/ 7 / 9 4", "% 100 % 9 5", "sqr abs - 3 10", "42", "- 1 * 2 3", "* 2 - 1 3",
+        "min - 10 4 max sqr 3 abs (-20)", "min 4 4", "max (-4) min 3 2", "abs 0", "abs - 2147483647 0",
+        "- 0 2147483647"}) {
+    TokenStream tokens(input);
+    const auto expression = Parse(tokens);
+    Compile(*expression, program);
+    const NativeProgram native(program);
+    REQUIRE(native.IsNative() == kExpectNative);
+    REQUIRE(native.Execute() == expression->Calculate());
+    REQUIRE(native.Execute() == expression->Calculate());  // код переиспользуется
+  }
+
+  ExpressionPtr deep = std::make_unique<Constant>(1);
+  for (int i = 0; i < 1'000; ++i) {
+    deep = std::make_unique<Subtract>(std::make_unique<Constant>(i), std::move(deep));
+    deep = std::make_unique<Maximum>(std::move(deep), std::make_unique<Minus>(std::make_unique<Constant>(i)));
+  }
+  Compile(*deep, program);
+  const NativeProgram native(program);
+  REQUIRE(native.Execute() == deep->Calculate());
+
+  REQUIRE_THROWS_AS(NativeProgram(Program{}), std::invalid_argument);
+}
+
+TEST_CASE("VariantExpression", "[VariantExpression]") {
+  for (const std::string_view input : {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "(+ 7)",
+                                       "max 1 min 2 3", "/ (-7) 2", "% (-7) 2", "% 7 (-2)", "sqr abs - 3 10", "42",
+                                       "- 1 * 2 3", "min - 10 4 max sqr 3 abs (-20)"}) {
+    TokenStream tokens(input);
+    const auto expression = Parse(tokens);
+    const VariantExpression variant(*expression);
+    REQUIRE(variant.Calculate() == expression->Calculate());
+  }
+
+  TokenStream tokens("+ 1 * 2 (-3)");
+  const VariantExpression variant(*Parse(tokens));  // дерево-источник уже уничтожено
+  REQUIRE(variant.Size() == 6);
+  REQUIRE(variant.Calculate() == -5);
+
+  const Sum unsupported(std::make_unique<Constant>(1), std::make_unique<Twice>(std::make_unique<Constant>(2)));
+  REQUIRE_THROWS_AS(VariantExpression(unsupported), std::invalid_argument);
+}
+
+TEST_CASE("FlatExpression", "[FlatExpression]") {
+  for (const std::string_view input : {"* (+max abs + (-3) / 16 5 1) (-min sqr + 4 % 6 (+2) 100)", "(- 7)", "(+ 7)",
+                                       "max 1 min 2 3", "/ (-7) 2", "% (-7) 2", "% 7 (-2)", "sqr abs - 3 10", "42",
+                                       "- 1 * 2 3", "min - 10 4 max sqr 3 abs (-20)"}) {
+    TokenStream tokens(input);
+    const auto expression = Parse(tokens);
+    const FlatExpression flat(*expression);
+    REQUIRE(flat.Calculate() == expression->Calculate());
+    REQUIRE(flat.Calculate() == expression->Calculate());
+  }
+
+  Program program;
+  TokenStream tokens("- * 2 (+3) abs 4");  // узлы: 2 3 * 4 abs -
+  Compile(tokens, program);
+  const FlatExpression flat(program);
+  REQUIRE(flat.Size() == 6);
+  REQUIRE(flat.MemoryUsage() == 6 * 5 + 3 * 4);
+  REQUIRE(flat.MaxDepth() == 2);
+  REQUIRE(flat.Operation(5) == OpCode::kSubtract);
+  REQUIRE(flat.Left(5) == 2);
+  REQUIRE(flat.Right(5) == 4);
+  REQUIRE(flat.Calculate() == 2);
+
+  ExpressionPtr deep = std::make_unique<Constant>(1);
+  for (int i = 0; i < 100'000; ++i) {  // Calculate() на таком дереве переполнил бы стек
+    deep = std::make_unique<Subtract>(std::make_unique<Constant>(i % 5), std::move(deep));
+  }
+  const FlatExpression deep_flat(*deep);
+  REQUIRE(deep_flat.MaxDepth() == 100'001);  // правое дерево: стек растет до высоты дерева
+  REQUIRE(deep_flat.Calculate() == 1);
+
+  ExpressionPtr wide = std::make_unique<Constant>(1);
+  for (int i = 0; i < 100'000; ++i) {
+    wide = std::make_unique<Sum>(std::move(wide), std::make_unique<Constant>(1));
+  }
+  const FlatExpression wide_flat(*wide);
+  REQUIRE(wide_flat.Size() == 200'001);
+  REQUIRE(wide_flat.MaxDepth() == 2);
+  REQUIRE(wide_flat.Calculate() == 100'001);
+
+  REQUIRE_THROWS_AS(FlatExpression(Program{}), std::invalid_argument);
+
+  const Sum unsupported(std::make_unique<Constant>(1), std::make_unique<Twice>(std::make_unique<Constant>(2)));
+  REQUIRE_THROWS_AS(FlatExpression(unsupported), std::invalid_argument);
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../polish_notation/variant_expression.h"
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+
+namespace {
+
+// Шаг обхода: узел, который нужно обойти, или (expanded) узел, дети которого уже добавлены
+struct PendingNode {
+  const IExpression* node;
+  bool expanded;
+};
+
+// Узел вида Node из node, если node — объект Operation; номера детей снимаются со стека indices
+template <class Operation, class Node>
+bool TryAppend(const IExpression& node, std::vector<uint32_t>& indices, std::vector<VariantExpression::Node>& nodes) {
+  if (typeid(node) != typeid(Operation)) {
+    return false;
+  }
+  if constexpr (std::is_same_v<Node, VariantExpression::UnaryNode<Operation>>) {
+    nodes.emplace_back(Node{indices.back()});
+    indices.pop_back();
+  } else {
+    const auto right = indices.back();
+    indices.pop_back();
+    nodes.emplace_back(Node{indices.back(), right});
+    indices.pop_back();
+  }
+  return true;
+}
+
+template <class... Operations>
+bool TryAppendUnary(const IExpression& node, std::vector<uint32_t>& indices,
+                    std::vector<VariantExpression::Node>& nodes) {
+  return (TryAppend<Operations, VariantExpression::UnaryNode<Operations>>(node, indices, nodes) || ...);
+}
+
+template <class... Operations>
+bool TryAppendBinary(const IExpression& node, std::vector<uint32_t>& indices,
+                     std::vector<VariantExpression::Node>& nodes) {
+  return (TryAppend<Operations, VariantExpression::BinaryNode<Operations>>(node, indices, nodes) || ...);
+}
+
+}  // namespace
+
+VariantExpression::VariantExpression(const IExpression& expression) {
+  thread_local std::vector<PendingNode> pending;
+  thread_local std::vector<uint32_t> indices;  // номера готовых поддеревьев
+  pending.clear();
+  indices.clear();
+  pending.push_back({&expression, false});
+  while (!pending.empty()) {  // обход без рекурсии, как у Compile в bytecode.h
+    const auto [node, expanded] = pending.back();
+    pending.pop_back();
+    if (typeid(*node) == typeid(Constant)) {
+      indices.push_back(static_cast<uint32_t>(nodes_.size()));
+      nodes_.emplace_back(ConstantNode{static_cast<const Constant*>(node)->Value()});
+      continue;
+    }
+    if (expanded) {
+      if (!TryAppendUnary<Square, AbsoluteValue, Minus, Plus>(*node, indices, nodes_) &&
+          !TryAppendBinary<Multiply, Sum, Subtract, Divide, Residual, Maximum, Minimum>(*node, indices, nodes_)) {
+        throw std::invalid_argument(std::string("VariantExpression: unsupported expression node ") +
+                                    typeid(*node).name());
+      }
+      indices.push_back(static_cast<uint32_t>(nodes_.size() - 1));
+      continue;
+    }
+    pending.push_back({node, true});
+    if (const auto* unary = dynamic_cast<const IUnaryOperation*>(node)) {
+      pending.push_back({&unary->Operand(), false});
+    } else if (const auto* binary = dynamic_cast<const IBinaryOperation*>(node)) {
+      pending.push_back({&binary->Right(), false});  // левый аргумент снимается со стека первым
+      pending.push_back({&binary->Left(), false});
+    }
+  }
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_VARIANT_EXPRESSION_H
+#define MY_VARIANT_EXPRESSION_H
+
+#include "expressions.h"
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// Копия дерева IExpression в закрытом представлении: узел — std::variant по конкретным классам из
+// expressions.h, дети задаются номерами в общем массиве. Вычисление идет через std::visit, то есть
+// переходом по номеру альтернативы вместо двух виртуальных вызовов на узел, а операции (статические
+// Apply тех же классов) встраиваются в место вызова, так что результат совпадает с Calculate().
+// Как и Calculate(), вычисление рекурсивно. Дерево-источник после построения не нужно
+class VariantExpression {
+ public:
+  struct ConstantNode {
+    int value;
+  };
+
+  template <class Operation>
+  struct UnaryNode {
+    uint32_t operand;
+  };
+
+  template <class Operation>
+  struct BinaryNode {
+    uint32_t left;
+    uint32_t right;
+  };
+
+  using Node = std::variant<ConstantNode, UnaryNode<Square>, UnaryNode<AbsoluteValue>, UnaryNode<Minus>,
+                            UnaryNode<Plus>, BinaryNode<Multiply>, BinaryNode<Sum>, BinaryNode<Subtract>,
+                            BinaryNode<Divide>, BinaryNode<Residual>, BinaryNode<Maximum>, BinaryNode<Minimum>>;
+
+ private:
+  std::vector<Node> nodes_;  // дети раньше родителей, корень последний
+
+  template <class Operation>
+  int Calculate(const UnaryNode<Operation>& node) const {
+    return Operation::Apply(Calculate(node.operand));
+  }
+
+  template <class Operation>
+  int Calculate(const BinaryNode<Operation>& node) const {
+    const auto x = Calculate(node.left);  // порядок вычисления аргументов тот же, что у IBinaryOperation
+    const auto y = Calculate(node.right);
+    return Operation::Apply(x, y);
+  }
+
+  int Calculate(const ConstantNode& node) const {
+    return node.value;
+  }
+
+  int Calculate(uint32_t index) const {
+    return std::visit([this](const auto& node) { return Calculate(node); }, nodes_[index]);
+  }
+
+ public:
+  // Узлы, не объявленные в expressions.h, не поддерживаются: бросается std::invalid_argument
+  explicit VariantExpression(const IExpression& expression);
+
+  int Calculate() const {
+    return Calculate(static_cast<uint32_t>(nodes_.size() - 1));
+  }
+
+  size_t Size() const {
+    return nodes_.size();
+  }
+};
+
+#endif  // MY_VARIANT_EXPRESSION_H
@@ -0,0 +1,97 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "../tokenize/tokenize.h"
+#include "../polish_notation/bytecode.h"
+#include "../reverse_polish_notation/reverse_polish_notation.h"
+
+namespace {
+
+// Открытая скобка: сколько значений было на стеке до нее
+struct Group {
+  CompactToken token;
+  size_t base;
+};
+
+thread_local std::vector<int> values;    // стек значений для ValueBuilder
+thread_local std::vector<Group> groups;  // стек открытых скобок
+
+int EvaluatePostfix(TokenStream& tokens) {
+  ValueBuilder builder(values);
+  groups.clear();
+
+  while (!tokens.Empty()) {
+    const auto token = tokens.Next();
+    const auto available = values.size() - (groups.empty() ? 0 : groups.back().base);  // значения текущей скобки
+
+    switch (token.kind) {
+      case TokenKind::kUnknown:
+        throw UnknownSymbolError("Unknown token: " + std::string(tokens.Text(token)), token.offset, token.length);
+      case TokenKind::kNumber:
+        builder.Number(token.value);
+        break;
+      case TokenKind::kOpeningBracket:
+        groups.push_back({token, values.size()});
+        break;
+      case TokenKind::kClosingBracket:
+        if (groups.empty()) {
+          throw WrongExpressionError("No matching (", token.offset, token.length);
+        }
+        if (available != 1) {
+          throw WrongExpressionError(available == 0 ? "too few arguments" : "too many arguments", token.offset,
+                                     token.length);
+        }
+        groups.pop_back();
+        break;
+      case TokenKind::kSqr:
+      case TokenKind::kAbs:
+        if (available < 1) {
+          throw WrongExpressionError("too few arguments", token.offset, token.length);
+        }
+        builder.Unary(token.kind);
+        break;
+      case TokenKind::kPlus:
+      case TokenKind::kMinus:
+        if (available < 1) {
+          throw WrongExpressionError("too few arguments", token.offset, token.length);
+        }
+        if (available == 1) {
+          builder.Unary(token.kind);
+        } else {
+          builder.Binary(token.kind);
+        }
+        break;
+      default:  // остальные операции бинарные
+        if (available < 2) {
+          throw WrongExpressionError("too few arguments", token.offset, token.length);
+        }
+        builder.Binary(token.kind);
+        break;
+    }
+  }
+
+  if (!groups.empty()) {
+    throw WrongExpressionError("No matching )", groups.back().token.offset, groups.back().token.length);
+  }
+  if (values.size() != 1) {
+    throw WrongExpressionError(values.empty() ? "too few arguments" : "too many arguments", tokens.Offset(), 0);
+  }
+  return builder.Result().Get();  // отложенное деление на ноль выполняется только после разбора всего входа
+}
+
+}  // namespace
+
+int CalculateReversePolishNotation(std::string_view input) {
+  TokenStream tokens(input);  // токены читаются по мере вычисления
+  try {
+    return EvaluatePostfix(tokens);
+  } catch (const UnknownSymbolError&) {  // недопустимый символ дальше по входу важнее ошибки разбора
+    tokens.ScanRest();
+    throw;
+  } catch (const WrongExpressionError&) {
+    tokens.ScanRest();
+    throw;
+  }
+}
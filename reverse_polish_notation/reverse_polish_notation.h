@@ -0,0 +1,18 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#ifndef MY_REVERSE_POLISH_NOTATION_H
+#define MY_REVERSE_POLISH_NOTATION_H
+
+#include <string_view>
+#include "../polish_notation/polish_notation.h"  // UnknownSymbolError, WrongExpressionError
+
+// Вычисление выражения в обратной польской нотации, например "3 4 + 2 *". Операции те же, что в
+// польской нотации; + и - бинарные, если в текущей скобке есть хотя бы два значения, иначе унарные
+// ("5 -" равно -5). Скобки только группируют и должны давать ровно одно значение. Вычисление идет
+// одним проходом на стеке значений, без дерева и рекурсии
+int CalculateReversePolishNotation(std::string_view input);
+
+#endif  // MY_REVERSE_POLISH_NOTATION_H
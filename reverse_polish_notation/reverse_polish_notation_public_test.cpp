@@ -0,0 +1,103 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+#include <string>
+#include "reverse_polish_notation.h"
+
+TEST_CASE("ConstantExpression", "[ReversePolishNotation]") {
+  REQUIRE(CalculateReversePolishNotation("5") == 5);
+  REQUIRE(CalculateReversePolishNotation("  5 ") == 5);
+  REQUIRE(CalculateReversePolishNotation("(((5)))") == 5);
+}
+
+TEST_CASE("UnaryOperations", "[ReversePolishNotation]") {
+  REQUIRE(CalculateReversePolishNotation("5 +") == 5);
+  REQUIRE(CalculateReversePolishNotation("5-") == -5);
+  REQUIRE(CalculateReversePolishNotation("5 sqr") == 25);
+  REQUIRE(CalculateReversePolishNotation("5 - abs") == 5);
+  REQUIRE(CalculateReversePolishNotation("5 - + - -") == -5);
+}
+
+TEST_CASE("BinaryOperations", "[ReversePolishNotation]") {
+  REQUIRE(CalculateReversePolishNotation("4 9 +") == 13);
+  REQUIRE(CalculateReversePolishNotation("4 9 -") == -5);
+  REQUIRE(CalculateReversePolishNotation("4 9 *") == 36);
+  REQUIRE(CalculateReversePolishNotation("4 9 /") == 0);
+  REQUIRE(CalculateReversePolishNotation("4 9 %") == 4);
+  REQUIRE(CalculateReversePolishNotation("4 9 min") == 4);
+  REQUIRE(CalculateReversePolishNotation("4 9 max") == 9);
+}
+
+TEST_CASE("GeneralCases", "[ReversePolishNotation]") {
+  // те же выражения, что и в тестах польской нотации
+  REQUIRE(CalculateReversePolishNotation("3 2 (4 -) - +") == 9);
+  REQUIRE(CalculateReversePolishNotation("2 3 max (3 -) abs sqr min") == 3);
+  REQUIRE(CalculateReversePolishNotation("2 4 5 0 min + - sqr sqr") == 16);
+  REQUIRE(CalculateReversePolishNotation("11 22 + 3 + 4 + 5 + 6 + 7 + 8 +") == 66);
+  REQUIRE(CalculateReversePolishNotation("(3 -) (5 1 2 + *) + 9 - 4 (2 -) / +") == 1);
+  REQUIRE(CalculateReversePolishNotation("(3 -) 16 5 / + abs 1 max (4 6 2 % + sqr 100 min -) *") == -16);
+  REQUIRE(CalculateReversePolishNotation("1 (5 -) +") == -4);  // скобка делает минус унарным
+}
+
+TEST_CASE("DeepExpression", "[ReversePolishNotation]") {
+  std::string input = "1";
+  for (int i = 0; i < 100'000; ++i) {
+    input += " 1 +";
+  }
+  REQUIRE(CalculateReversePolishNotation(input) == 100'001);
+
+  input = std::string(100'000, '(') + "7" + std::string(100'000, ')');
+  REQUIRE(CalculateReversePolishNotation(input) == 7);
+}
+
+TEST_CASE("UnknownSymbolError", "[Exceptions]") {
+  REQUIRE_THROWS_AS((void)CalculateReversePolishNotation("whatisthis"), UnknownSymbolError);  // NOLINT
+  try {
+    (void)CalculateReversePolishNotation("3 4 + Square 6");
+    FAIL("no exception");
+  } catch (const UnknownSymbolError& error) {
+    REQUIRE(error.Offset() == 6);
+    REQUIRE(error.Length() == 6);
+  }
+}
+
+TEST_CASE("WrongExpressionError", "[Exceptions]") {
+  for (const std::string_view input : {"", "sqr", "abs", "+", "-", "*", "/", "%", "min", "max", "1 *", "1 min", "()",
+                                       "1 2", "1 2 3 +", "(1 2)", "(1", ")", "1 )", "1 ( 2 +)", "(1) (2)"}) {
+    INFO(input);
+    REQUIRE_THROWS_AS((void)CalculateReversePolishNotation(input), WrongExpressionError);  // NOLINT
+  }
+
+  try {
+    (void)CalculateReversePolishNotation("1 (2 3) +");
+    FAIL("no exception");
+  } catch (const WrongExpressionError& error) {
+    REQUIRE(error.Offset() == 6);
+    REQUIRE(error.Length() == 1);
+  }
+  try {
+    (void)CalculateReversePolishNotation("1 (2 +");
+    FAIL("no exception");
+  } catch (const WrongExpressionError& error) {
+    REQUIRE(error.Offset() == 2);
+    REQUIRE(error.Length() == 1);
+  }
+}
+
+TEST_CASE("ErrorPrecedence", "[Exceptions]") {  // недопустимый символ в любом месте входа важнее ошибки разбора
+  for (const std::string_view input : {"1 2 #", "+ 1 #", "1 foo #", "(1 2) 3 #"}) {
+    INFO(input);
+    REQUIRE_THROWS_AS((void)CalculateReversePolishNotation(input), TokenizeError);  // NOLINT
+  }
+  REQUIRE_THROWS_AS((void)CalculateReversePolishNotation("+ 1 2"), WrongExpressionError);  // NOLINT
+}
+
+TEST_CASE("DivisionByZero", "[Exceptions]") {
+  // деление откладывается, поэтому ошибка структуры после него сообщается без деления
+  REQUIRE_THROWS_AS((void)CalculateReversePolishNotation("1 0 / 2"), WrongExpressionError);  // NOLINT
+  REQUIRE_THROWS_AS((void)CalculateReversePolishNotation("1 0 % foo"), UnknownSymbolError);  // NOLINT
+}
@@ -4,79 +4,678 @@
 // Подробности смотрите в файле LICENSE
 
 #include "../tokenize/tokenize.h"
-#include <cctype>
-#include <unordered_map>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <span>
 #include <stdexcept>
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TOKENIZE_X86_SIMD
+#include <immintrin.h>
+#endif
 
-// Храним ключ - значение
-static const std::unordered_map<char, Token> kSymbolToToken{
-    {'+', PlusToken{}},     {'-', MinusToken{}},          {'/', DivideToken{}},        {'%', ResidualToken{}},
-    {'*', MultiplyToken{}}, {'(', OpeningBracketToken{}}, {')', ClosingBracketToken{}}};
+// Класс символа входной строки
+enum class CharClass : uint8_t { kInvalid, kSpace, kDigit, kLetter, kSymbol };
 
-static const std::unordered_map<std::string_view, Token> kWordToToken{
-    {"min", MinToken()}, {"max", MaxToken()}, {"abs", AbsToken()}, {"sqr", SqrToken()}};
+struct CharInfo {
+  CharClass char_class = CharClass::kInvalid;
+  TokenKind kind = TokenKind::kUnknown;  // вид токена для операторов и скобок
+};
 
-// Для корректрой работы isspace на некоторых системах
-// проверяет, является ли символ пробельным
-static bool IsSpace(char symbol) {
-  return std::isspace(static_cast<unsigned char>(symbol));
+// Таблица классов всех 256 байт строится на этапе компиляции, поэтому во внутреннем цикле
+// вместо поиска по хеш-таблице и вызова std::isspace остается одно обращение по индексу.
+// Пробельные символы совпадают с std::isspace в локали "C"
+static constexpr std::array<CharInfo, 256> MakeCharTable() {
+  std::array<CharInfo, 256> table{};
+  for (const unsigned char symbol : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+    table[symbol].char_class = CharClass::kSpace;
+  }
+  for (unsigned char symbol = '0'; symbol <= '9'; ++symbol) {
+    table[symbol].char_class = CharClass::kDigit;
+  }
+  for (unsigned char symbol = 'a'; symbol <= 'z'; ++symbol) {
+    table[symbol].char_class = CharClass::kLetter;
+    table[symbol - 'a' + 'A'].char_class = CharClass::kLetter;
+  }
+  const std::pair<unsigned char, TokenKind> symbols[] = {
+      {'+', TokenKind::kPlus},     {'-', TokenKind::kMinus},          {'/', TokenKind::kDivide},
+      {'%', TokenKind::kResidual}, {'*', TokenKind::kMultiply},       {'(', TokenKind::kOpeningBracket},
+      {')', TokenKind::kClosingBracket}};
+  for (const auto& [symbol, kind] : symbols) {
+    table[symbol] = {CharClass::kSymbol, kind};
+  }
+  return table;
 }
 
-// Проверка, является ли символ буквой
-static bool IsLetter(char symbol) {
-  return ('a' <= symbol && symbol <= 'z') || ('A' <= symbol && symbol <= 'Z');
-}
+static constexpr auto kCharTable = MakeCharTable();
 
-// Проверка, является ли символ цифрой
-static bool IsDigit(char symbol) {
-  return '0' <= symbol && symbol <= '9';
+static constexpr CharClass ClassOf(char symbol) {
+  return kCharTable[static_cast<unsigned char>(symbol)].char_class;
 }
 
-// Парсинг числа
-static NumberToken ParseNumber(std::string_view input, size_t& pos) {
-  int value = 0;
-  while (IsDigit(input[pos])) {
-    value = value * 10 + (input[pos] - '0');
+// Скалярный поиск конца серии символов класса kClass, начинающейся с pos
+template <CharClass kClass>
+static size_t ScalarRunEnd(std::string_view input, size_t pos) {
+  while (pos < input.size() && ClassOf(input[pos]) == kClass) {
     ++pos;
   }
-  return {value};
+  return pos;
+}
+
+#ifdef TOKENIZE_X86_SIMD
+// Маска байтов вектора, принадлежащих классу kClass (пробелы, цифры или буквы).
+// Знаковые сравнения отсекают байты >= 0x80, которые не относятся ни к одному из классов
+template <CharClass kClass>
+static __m128i ClassMask(__m128i bytes) {
+  if constexpr (kClass == CharClass::kSpace) {  // ' ' и '\t'..'\r'
+    const auto control = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('\t' - 1)),
+                                       _mm_cmplt_epi8(bytes, _mm_set1_epi8('\r' + 1)));
+    return _mm_or_si128(control, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+  } else if constexpr (kClass == CharClass::kDigit) {
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(bytes, _mm_set1_epi8('9' + 1)));
+  } else {
+    const auto lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));  // приведение букв к нижнему регистру
+    return _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+  }
+}
+
+template <CharClass kClass>
+__attribute__((target("avx2"))) static __m256i ClassMask(__m256i bytes) {
+  if constexpr (kClass == CharClass::kSpace) {
+    const auto control = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('\t' - 1)),
+                                          _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), bytes));
+    return _mm256_or_si256(control, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+  } else if constexpr (kClass == CharClass::kDigit) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('0' - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), bytes));
+  } else {
+    const auto lower = _mm256_or_si256(bytes, _mm256_set1_epi8(0x20));
+    return _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+  }
+}
+
+// Маска тех из 16 байт начиная с data, которые не принадлежат классу kClass
+template <CharClass kClass>
+static uint32_t Sse2Mismatch(const char* data) {
+  const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  return static_cast<uint32_t>(_mm_movemask_epi8(ClassMask<kClass>(bytes))) ^ 0xFFFFu;
+}
+
+// Поиск конца серии по 16 байт за шаг (SSE2 есть на любом x86-64)
+template <CharClass kClass>
+static size_t Sse2RunEnd(std::string_view input, size_t pos) {
+  for (; pos + 16 <= input.size(); pos += 16) {
+    if (const auto mask = Sse2Mismatch<kClass>(input.data() + pos); mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+  return ScalarRunEnd<kClass>(input, pos);
+}
+
+// Поиск конца серии по 32 байта за шаг
+template <CharClass kClass>
+__attribute__((target("avx2"))) static size_t Avx2RunEnd(std::string_view input, size_t pos) {
+  for (; pos + 32 <= input.size(); pos += 32) {
+    const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input.data() + pos));
+    const auto mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ClassMask<kClass>(bytes)));
+    if (mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+  return Sse2RunEnd<kClass>(input, pos);
+}
+
+static bool HasAvx2() {
+  __builtin_cpu_init();  // нужен, так как проверка выполняется при статической инициализации
+  return __builtin_cpu_supports("avx2");
+}
+
+static const bool kHasAvx2 = HasAvx2();
+#endif
+
+// Конец серии символов класса kClass, начинающейся с pos. Первые 16 байт проверяются одной
+// SSE2-инструкцией (короткие серии на этом и заканчиваются), а длинные серии дочитываются
+// по 32 байта за шаг, если процессор поддерживает AVX2
+template <CharClass kClass>
+static size_t RunEnd(std::string_view input, size_t pos) {
+#ifdef TOKENIZE_X86_SIMD
+  if (pos + 16 <= input.size()) {
+    if (const auto mask = Sse2Mismatch<kClass>(input.data() + pos); mask != 0) {
+      return pos + __builtin_ctz(mask);
+    }
+    return kHasAvx2 ? Avx2RunEnd<kClass>(input, pos + 16) : Sse2RunEnd<kClass>(input, pos + 16);
+  }
+#endif
+  return ScalarRunEnd<kClass>(input, pos);
+}
+
+static constexpr uint64_t kAsciiZeros = 0x3030303030303030;  // восемь символов '0'
+
+// Значение не более чем восьми десятичных цифр за несколько умножений над 64-битным словом (SWAR).
+// Цифры кладутся в старшие байты слова, а недостающие младшие разряды заполняются символом '0'
+static uint32_t ParseDigitsSwar(const char* digits, size_t count) {
+  if constexpr (std::endian::native != std::endian::little) {  // раскладка байтов ниже рассчитана на little-endian
+    uint32_t value = 0;
+    for (size_t i = 0; i < count; ++i) {
+      value = value * 10 + (digits[i] - '0');
+    }
+    return value;
+  }
+  uint64_t chunk = kAsciiZeros;
+  std::memcpy(reinterpret_cast<char*>(&chunk) + (8 - count), digits, count);
+  chunk -= kAsciiZeros;
+  chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FF;       // пары цифр
+  chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFF;     // четверки цифр
+  return static_cast<uint32_t>((chunk * 10000 + (chunk >> 32)));  // восемь цифр
+}
+
+static bool IsEightZeros(const char* data) {
+  uint64_t chunk = 0;
+  std::memcpy(&chunk, data, 8);
+  return chunk == kAsciiZeros;
+}
+
+static constexpr size_t kMaxDigits = std::numeric_limits<int>::digits10 + 1;
+
+// Число без ведущих нулей; position — позиция литерала для сообщения об ошибке
+static std::string_view SignificantDigits(std::string_view digits, size_t position) {
+  size_t first = 0;
+  while (digits.size() - first >= 8 && IsEightZeros(digits.data() + first)) {
+    first += 8;
+  }
+  while (first < digits.size() && digits[first] == '0') {
+    ++first;
+  }
+  if (digits.size() - first > kMaxDigits) {
+    throw TokenizeError("number is too large", position);
+  }
+  return digits.substr(first);
+}
+
+// Значение литерала. Значащие цифры разбираются блоками по восемь; число, не помещающееся
+// в int, считается ошибкой, а не переполняется молча
+static int32_t NumberValue(std::string_view digits, size_t position) {
+  digits = SignificantDigits(digits, position);
+  uint64_t value = 0;
+  if (digits.size() > 8) {
+    value = ParseDigitsSwar(digits.data(), digits.size() - 8) * uint64_t{100'000'000};
+    digits.remove_prefix(digits.size() - 8);
+  }
+  value += ParseDigitsSwar(digits.data(), digits.size());
+  if (value > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+    throw TokenizeError("number is too large", position);
+  }
+  return static_cast<int32_t>(value);
+}
+
+// Длина токена хранится в 24 битах; более длинные слова получают максимальную длину
+static uint32_t TokenLength(size_t length) {
+  return static_cast<uint32_t>(std::min<size_t>(length, (size_t{1} << 24) - 1));
+}
+
+// Парсинг числа; base — смещение input относительно начала всего входа
+static CompactToken ParseNumber(std::string_view input, size_t& pos, size_t base) {
+  const auto begin = pos;
+  pos = RunEnd<CharClass::kDigit>(input, pos + 1);
+  return {TokenKind::kNumber, TokenLength(pos - begin), static_cast<uint32_t>(base + begin),
+          NumberValue(input.substr(begin, pos - begin), base + begin)};
+}
+
+// Ключевые слова ищутся по идеальному хешу: ключ слова собирается из длины, первой, средней и
+// последней букв (а если по ним слова не различить — из хеша всего слова) и умножается на
+// подобранную константу seed, после чего старшие bits бит дают номер ячейки без коллизий.
+// Поиск слова — одно умножение и одно сравнение строк
+struct KeywordSlot {
+  std::string_view word;
+  TokenKind kind = TokenKind::kUnknown;
+};
+
+struct PerfectHash {
+  uint32_t seed = 1;
+  uint32_t bits = 1;
+  bool full_key = false;  // ключом служит хеш FNV-1a всего слова
+};
+
+static constexpr uint32_t KeywordKey(std::string_view word, bool full_key) {
+  if (full_key) {
+    uint32_t hash = 2166136261u;
+    for (const auto symbol : word) {
+      hash = (hash ^ static_cast<unsigned char>(symbol)) * 16777619u;
+    }
+    return hash;
+  }
+  return static_cast<uint32_t>(static_cast<unsigned char>(word.front())) << 24 |
+         static_cast<uint32_t>(static_cast<unsigned char>(word[word.size() / 2])) << 16 |
+         static_cast<uint32_t>(static_cast<unsigned char>(word.back())) << 8 | (word.size() & 0xFF);
+}
+
+static constexpr uint32_t KeywordIndex(std::string_view word, const PerfectHash& hash) {
+  return (KeywordKey(word, hash.full_key) * hash.seed) >> (32 - hash.bits);
+}
+
+// Подбор seed и размера таблицы, при которых все слова попадают в разные ячейки
+static constexpr PerfectHash FindPerfectHash(std::span<const KeywordSlot> words) {
+  const auto is_injective = [&words](const PerfectHash& hash, bool by_key) {
+    for (size_t i = 0; i < words.size(); ++i) {
+      for (size_t j = 0; j < i; ++j) {
+        const auto lhs = by_key ? KeywordKey(words[i].word, hash.full_key) : KeywordIndex(words[i].word, hash);
+        const auto rhs = by_key ? KeywordKey(words[j].word, hash.full_key) : KeywordIndex(words[j].word, hash);
+        if (lhs == rhs) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  uint32_t min_bits = 1;
+  while ((size_t{1} << min_bits) < words.size()) {
+    ++min_bits;
+  }
+  for (const bool full_key : {false, true}) {
+    if (!is_injective({1, 1, full_key}, true)) {
+      continue;
+    }
+    for (auto bits = min_bits; bits <= min_bits + 4; ++bits) {
+      for (uint32_t attempt = 1; attempt <= 4096; ++attempt) {
+        const PerfectHash hash{(0x9E3779B1u * attempt) | 1u, bits, full_key};
+        if (is_injective(hash, false)) {
+          return hash;
+        }
+      }
+    }
+  }
+  throw std::logic_error("Cannot build perfect hash for keywords");
+}
+
+static constexpr KeywordSlot kDefaultKeywords[] = {
+    {"min", TokenKind::kMin}, {"max", TokenKind::kMax}, {"abs", TokenKind::kAbs}, {"sqr", TokenKind::kSqr}};
+
+static constexpr auto kDefaultHash = FindPerfectHash(kDefaultKeywords);
+
+static constexpr auto MakeDefaultSlots() {
+  std::array<KeywordSlot, size_t{1} << kDefaultHash.bits> slots{};
+  for (const auto& keyword : kDefaultKeywords) {
+    slots[KeywordIndex(keyword.word, kDefaultHash)] = keyword;
+  }
+  return slots;
+}
+
+static constexpr auto kDefaultSlots = MakeDefaultSlots();
+
+// Текущая таблица; заменяется при регистрации новых слов
+static PerfectHash keyword_hash = kDefaultHash;
+static const KeywordSlot* keyword_slots = kDefaultSlots.data();
+static size_t keyword_max_length = 3;  // слова длиннее заведомо не ключевые
+
+static TokenKind FindKeyword(std::string_view word) {
+  const auto& slot = keyword_slots[KeywordIndex(word, keyword_hash)];
+  return slot.word == word ? slot.kind : TokenKind::kUnknown;
+}
+
+void RegisterKeyword(std::string_view word, TokenKind kind) {
+  if (word.empty() || word.size() >= (size_t{1} << 24) ||
+      !std::all_of(word.begin(), word.end(), [](char symbol) { return ClassOf(symbol) == CharClass::kLetter; })) {
+    throw std::invalid_argument("Keyword must be a non-empty word of latin letters");
+  }
+  if (kind == TokenKind::kNumber || kind == TokenKind::kUnknown) {
+    throw std::invalid_argument("Keyword must denote an operation");
+  }
+  static std::deque<std::string> storage;  // владеет текстом зарегистрированных слов
+  static std::vector<KeywordSlot> words(std::begin(kDefaultKeywords), std::end(kDefaultKeywords));
+  static std::vector<KeywordSlot> slots;
+
+  auto new_words = words;
+  if (auto it = std::find_if(new_words.begin(), new_words.end(), [word](const auto& slot) { return slot.word == word; });
+      it != new_words.end()) {
+    it->kind = kind;
+  } else {
+    new_words.push_back({storage.emplace_back(word), kind});
+  }
+  const auto hash = FindPerfectHash(new_words);
+  std::vector<KeywordSlot> new_slots(size_t{1} << hash.bits);
+  for (const auto& keyword : new_words) {
+    new_slots[KeywordIndex(keyword.word, hash)] = keyword;
+  }
+  words = std::move(new_words);
+  slots = std::move(new_slots);
+  keyword_hash = hash;
+  keyword_slots = slots.data();
+  keyword_max_length = std::max(keyword_max_length, word.size());
 }
 
 // Парсинг букв
-static Token ParseWord(std::string_view input, size_t& pos) {
-  size_t word_size = 0;
-  while (IsLetter(input[pos])) {
-    ++word_size;
-    ++pos;
+static CompactToken ParseWord(std::string_view input, size_t& pos, size_t base) {
+  const auto begin = pos;
+  pos = RunEnd<CharClass::kLetter>(input, pos + 1);
+  const auto kind = FindKeyword(input.substr(begin, pos - begin));  // поиск токена; для обычного слова — kUnknown
+  return {kind, TokenLength(pos - begin), static_cast<uint32_t>(base + begin), 0};
+}
+
+// Чтение очередного токена начиная с pos; возвращает false, если токенов больше нет.
+// base — смещение input относительно начала всего входа, оно прибавляется к позициям токенов и ошибок
+static bool ReadToken(std::string_view input, size_t& pos, CompactToken& token, size_t base = 0) {
+  while (pos < input.size()) {
+    const auto& info = kCharTable[static_cast<unsigned char>(input[pos])];
+    switch (info.char_class) {
+      case CharClass::kSpace:
+        pos = RunEnd<CharClass::kSpace>(input, pos + 1);
+        continue;
+      case CharClass::kSymbol:
+        token = {info.kind, 1, static_cast<uint32_t>(base + pos), 0};
+        ++pos;
+        return true;
+      case CharClass::kDigit:
+        token = ParseNumber(input, pos, base);
+        return true;
+      case CharClass::kLetter:
+        token = ParseWord(input, pos, base);
+        return true;
+      case CharClass::kInvalid:
+        throw TokenizeError("unknown symbol", base + pos);
+    }
+  }
+  return false;
+}
+
+// Смещения в CompactToken 32-битные
+static void CheckInputSize(std::string_view input) {
+  if (input.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("Input is too long to tokenize");
   }
-  const auto word = input.substr(pos - word_size, word_size);
-  if (auto it = kWordToToken.find(word); it != kWordToToken.end()) { // поиск токена
-    return it->second;
+}
+
+Token ToToken(const CompactToken& token, std::string_view input) {
+  switch (token.kind) {
+    case TokenKind::kPlus:
+      return PlusToken{};
+    case TokenKind::kMinus:
+      return MinusToken{};
+    case TokenKind::kMultiply:
+      return MultiplyToken{};
+    case TokenKind::kDivide:
+      return DivideToken{};
+    case TokenKind::kResidual:
+      return ResidualToken{};
+    case TokenKind::kOpeningBracket:
+      return OpeningBracketToken{};
+    case TokenKind::kClosingBracket:
+      return ClosingBracketToken{};
+    case TokenKind::kMin:
+      return MinToken{};
+    case TokenKind::kMax:
+      return MaxToken{};
+    case TokenKind::kAbs:
+      return AbsToken{};
+    case TokenKind::kSqr:
+      return SqrToken{};
+    case TokenKind::kNumber:
+      return NumberToken{token.value};
+    case TokenKind::kUnknown:
+      return UnknownToken{std::string(TokenText(token, input))};
+  }
+  throw std::logic_error("Invalid token kind");
+}
+
+// Дописывает упакованные токены в конец любого контейнера с push_back
+template <class Tokens>
+static void AppendCompact(std::string_view input, Tokens& tokens) {
+  CheckInputSize(input);
+  size_t pos = 0;
+  CompactToken token;
+  while (ReadToken(input, pos, token)) {
+    tokens.push_back(token);
   }
-  return UnknownToken{std::string(word)};
+}
+
+std::vector<CompactToken> TokenizeCompact(std::string_view input) {
+  std::vector<CompactToken> tokens;
+  AppendCompact(input, tokens);
+  return tokens;
+}
+
+void TokenizeCompact(std::string_view input, std::vector<CompactToken>& tokens) {
+  AppendCompact(input, tokens);
+}
+
+std::pmr::vector<CompactToken> TokenizeCompact(std::string_view input, std::pmr::memory_resource* resource) {
+  std::pmr::vector<CompactToken> tokens(resource);
+  AppendCompact(input, tokens);
+  return tokens;
+}
+
+// Граница, на которой можно разрезать вход: не раньше pos и не внутри числа или слова
+static size_t SegmentBoundary(std::string_view input, size_t pos) {
+  if (pos == 0 || pos >= input.size()) {
+    return std::min(pos, input.size());
+  }
+  switch (ClassOf(input[pos - 1])) {
+    case CharClass::kDigit:
+      return RunEnd<CharClass::kDigit>(input, pos);
+    case CharClass::kLetter:
+      return RunEnd<CharClass::kLetter>(input, pos);
+    default:
+      return pos;
+  }
+}
+
+std::vector<CompactToken> TokenizeParallel(std::string_view input, size_t threads) {
+  constexpr size_t kMinSegmentSize = 1 << 16;  // меньшие куски не окупают запуск потока
+  CheckInputSize(input);
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = std::min(threads, input.size() / kMinSegmentSize);
+  if (threads <= 1) {
+    return TokenizeCompact(input);
+  }
+
+  std::vector<size_t> bounds{0};
+  for (size_t i = 1; i < threads; ++i) {
+    bounds.push_back(std::max(bounds.back(), SegmentBoundary(input, input.size() / threads * i)));
+  }
+  bounds.push_back(input.size());
+
+  std::vector<std::vector<CompactToken>> parts(threads);
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i] {
+      try {
+        const auto segment = input.substr(bounds[i], bounds[i + 1] - bounds[i]);
+        size_t pos = 0;
+        CompactToken token;
+        while (ReadToken(segment, pos, token, bounds[i])) {
+          parts[i].push_back(token);
+        }
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  for (const auto& error : errors) {  // первая по порядку ошибка, как и при последовательном разборе
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  size_t total = 0;
+  for (const auto& part : parts) {
+    total += part.size();
+  }
+  std::vector<CompactToken> tokens;
+  tokens.reserve(total);
+  for (const auto& part : parts) {
+    tokens.insert(tokens.end(), part.begin(), part.end());
+  }
+  return tokens;
 }
 
 std::vector<Token> Tokenize(std::string_view input) {
   std::vector<Token> tokens;
+  Tokenize(input, tokens);
+  return tokens;
+}
+
+void Tokenize(std::string_view input, std::vector<Token>& tokens) {
+  CheckInputSize(input);
   size_t pos = 0;
-  while (pos < input.size()) {
-    const auto symbol = input[pos];
-    if (IsSpace(symbol)) {
-      ++pos;
-      continue;
+  CompactToken token;
+  while (ReadToken(input, pos, token)) {
+    tokens.emplace_back(ToToken(token, input));
+  }
+}
+
+TokenStream::TokenStream(std::string_view input) : input_(input) {
+  CheckInputSize(input);
+  Advance();
+}
+
+void TokenStream::AdvanceSlow() {
+  has_current_ = ReadToken(input_, pos_, current_);
+}
+
+void TokenStream::ScanRest() {
+  CompactToken token;
+  while (ReadToken(input_, pos_, token)) {
+  }
+  has_current_ = false;
+}
+
+void ChunkedTokenizer::Feed(std::string_view chunk, std::vector<CompactToken>& tokens) {
+  size_t pos = 0;
+  if (state_ != State::kIdle) {  // продолжение числа или слова из прошлого фрагмента
+    pos = state_ == State::kNumber ? RunEnd<CharClass::kDigit>(chunk, 0) : RunEnd<CharClass::kLetter>(chunk, 0);
+    Extend(chunk.substr(0, pos));
+    if (pos == chunk.size()) {
+      position_ += chunk.size();
+      return;
     }
-    if (auto it = kSymbolToToken.find(symbol); it != kSymbolToToken.end()) {
-      tokens.emplace_back(it->second);
-      ++pos;
-    } else if (IsDigit(symbol)) {
-      tokens.emplace_back(ParseNumber(input, pos));
-    } else if (IsLetter(symbol)) {
-      tokens.emplace_back(ParseWord(input, pos));
-    } else {
-      throw std::runtime_error("Unknown symbol");
+    tokens.push_back(Flush());
+  }
+  CompactToken token;
+  while (ReadToken(chunk, pos, token, position_)) {
+    const auto last_class = ClassOf(chunk[pos - 1]);
+    if (pos == chunk.size() && last_class != CharClass::kSymbol) {  // токен может продолжиться дальше
+      auto begin = pos;
+      while (begin > 0 && ClassOf(chunk[begin - 1]) == last_class) {
+        --begin;
+      }
+      state_ = last_class == CharClass::kDigit ? State::kNumber : State::kWord;
+      pending_begin_ = position_ + begin;
+      Extend(chunk.substr(begin));
+      break;
     }
+    tokens.push_back(token);
   }
-  return tokens;
+  position_ += chunk.size();
+}
+
+void ChunkedTokenizer::Finish(std::vector<CompactToken>& tokens) {
+  if (state_ != State::kIdle) {
+    tokens.push_back(Flush());
+  }
+}
+
+void ChunkedTokenizer::Extend(std::string_view part) {
+  pending_length_ += part.size();
+  if (state_ == State::kNumber) {  // храним только значащие цифры, их не больше kMaxDigits
+    if (pending_text_.empty()) {
+      part = SignificantDigits(part, pending_begin_);
+    }
+    if (pending_text_.size() + part.size() > kMaxDigits) {
+      throw TokenizeError("number is too large", pending_begin_);
+    }
+    pending_text_ += part;
+  } else {  // начала хватает и для поиска ключевого слова, и для текста слова, ушедшего из буферов
+    const auto limit = std::max(keyword_max_length + 1, kWordPrefix);
+    if (pending_text_.size() < limit) {
+      pending_text_.append(part.substr(0, limit - pending_text_.size()));
+    }
+  }
+}
+
+CompactToken ChunkedTokenizer::Flush() {
+  CompactToken token{};
+  token.length = TokenLength(pending_length_);
+  token.offset = static_cast<uint32_t>(pending_begin_);
+  if (state_ == State::kNumber) {
+    token.kind = TokenKind::kNumber;
+    token.value = NumberValue(pending_text_, pending_begin_);
+  } else {
+    token.kind = pending_length_ <= keyword_max_length ? FindKeyword(pending_text_) : TokenKind::kUnknown;
+    word_prefix_.swap(pending_text_);
+    word_prefix_.resize(std::min(word_prefix_.size(), kWordPrefix));
+    word_begin_ = pending_begin_;
+  }
+  state_ = State::kIdle;
+  pending_text_.clear();
+  pending_length_ = 0;
+  return token;
+}
+
+ChunkedTokenStream::ChunkedTokenStream(std::istream& input, size_t chunk_size)
+    : input_(input), chunk_size_(chunk_size == 0 ? kDefaultChunkSize : chunk_size) {
+}
+
+void ChunkedTokenStream::Refill() {
+  tokens_.clear();
+  next_ = 0;
+  while (tokens_.empty() && !finished_) {
+    spare_.resize(chunk_size_);
+    input_.read(spare_.data(), static_cast<std::streamsize>(chunk_size_));
+    spare_.resize(static_cast<size_t>(input_.gcount()));
+    if (spare_.empty()) {
+      tokenizer_.Finish(tokens_);
+      finished_ = true;
+      break;
+    }
+    older_.swap(previous_);
+    previous_.swap(buffer_);
+    buffer_.swap(spare_);
+    tokenizer_.Feed(buffer_, tokens_);
+  }
+}
+
+void ChunkedTokenStream::ScanRest() {
+  while (!finished_) {
+    Refill();
+  }
+  tokens_.clear();
+  next_ = 0;
+}
+
+std::string_view ChunkedTokenStream::Text(const CompactToken& token) {
+  const std::string_view chunks[] = {older_, previous_, buffer_};
+  const auto window_size = older_.size() + previous_.size() + buffer_.size();
+  const auto window_begin = tokenizer_.Position() - window_size;
+  size_t begin = static_cast<uint32_t>(token.offset - static_cast<uint32_t>(window_begin));
+  if (begin >= window_size) {  // слово началось раньше хранимых фрагментов: известно только его начало
+    return token.offset == static_cast<uint32_t>(tokenizer_.WordBegin()) ? tokenizer_.WordPrefix()
+                                                                          : std::string_view{};
+  }
+  size_t index = 0;
+  while (begin >= chunks[index].size()) {  // ищем фрагмент, в котором начинается токен
+    begin -= chunks[index].size();
+    ++index;
+  }
+  if (begin + token.length <= chunks[index].size()) {
+    return chunks[index].substr(begin, token.length);
+  }
+  carry_.assign(chunks[index].substr(begin));
+  while (++index < std::size(chunks) && carry_.size() < token.length) {
+    carry_.append(chunks[index].substr(0, token.length - carry_.size()));
+  }
+  return carry_;
 }
 
 void PrintToken(const Token& token) {
@@ -7,10 +7,14 @@
 #define MY_TOKENIZE_H
 
 #include <vector>
+#include <memory_resource>
 #include <string>
 #include <string_view>
 #include <variant>
 #include <iostream>
+#include <stdexcept>
+#include <cstdint>
+#include <type_traits>
 
 struct PlusToken {};
 struct MinusToken {};
@@ -76,7 +80,328 @@ inline bool operator==(const UnknownToken& lhs, const UnknownToken& rhs) {
 using Token = std::variant<PlusToken, MinusToken, MultiplyToken, DivideToken, ResidualToken, OpeningBracketToken,
                            ClosingBracketToken, MinToken, MaxToken, AbsToken, SqrToken, NumberToken, UnknownToken>;
 
+// Ошибка токенизации: неизвестный символ или слишком большое число; хранит позицию во входной строке
+class TokenizeError : public std::runtime_error {
+  size_t position_;
+
+ public:
+  TokenizeError(const std::string& msg, size_t position)
+      : std::runtime_error("TokenizeError: " + msg + " at position " + std::to_string(position)), position_(position) {
+  }
+
+  size_t Position() const {
+    return position_;
+  }
+};
+
+// Вид токена; порядок совпадает с порядком альтернатив в Token
+enum class TokenKind : uint8_t {
+  kPlus,
+  kMinus,
+  kMultiply,
+  kDivide,
+  kResidual,
+  kOpeningBracket,
+  kClosingBracket,
+  kMin,
+  kMax,
+  kAbs,
+  kSqr,
+  kNumber,
+  kUnknown
+};
+
+// Упакованный токен в 12 байт: тривиально копируется, а разбирается через switch по kind.
+// offset и length задают положение токена во входной строке (для неизвестного слова по ним же
+// берется его текст, так что сама строка нигде не копируется), value хранит значение числа
+struct CompactToken {
+  TokenKind kind : 8;
+  uint32_t length : 24;
+  uint32_t offset;
+  int32_t value;
+};
+
+static_assert(sizeof(CompactToken) == 12);
+static_assert(std::is_trivially_copyable_v<CompactToken>);
+
+inline bool operator==(const CompactToken& lhs, const CompactToken& rhs) {
+  return lhs.kind == rhs.kind && lhs.length == rhs.length && lhs.offset == rhs.offset && lhs.value == rhs.value;
+}
+
+// Текст токена во входной строке
+inline std::string_view TokenText(const CompactToken& token, std::string_view input) {
+  return input.substr(token.offset, token.length);
+}
+
+// Представление упакованного токена в виде Token для совместимости со старым интерфейсом
+Token ToToken(const CompactToken& token, std::string_view input);
+
 void PrintToken(const Token& token);
 
+// Регистрирует дополнительное слово, распознаваемое как токен вида kind (например, "minimum" как kMin),
+// и перестраивает таблицу ключевых слов. Вызывается при старте программы, до токенизации в других потоках
+void RegisterKeyword(std::string_view word, TokenKind kind);
+
+// Смещения токенов 32-битные, поэтому вход длиннее 4 ГБ отвергается с std::length_error
 std::vector<Token> Tokenize(std::string_view input);
-#endif  // MY_TOKENIZE_H
\ No newline at end of file
+
+std::vector<CompactToken> TokenizeCompact(std::string_view input);
+
+// Параллельная токенизация очень длинного входа: строка режется на куски по пробелам и операторам,
+// куски разбираются в threads потоках (0 — по числу ядер) и склеиваются; результат и ошибки
+// совпадают с TokenizeCompact. Короткий вход разбирается в текущем потоке
+std::vector<CompactToken> TokenizeParallel(std::string_view input, size_t threads = 0);
+
+// Перегрузки, дописывающие токены в конец буфера вызывающего. Если буфер переиспользуется
+// (clear() между вызовами), то после прогрева память не выделяется вовсе; для Token это верно,
+// пока неизвестные слова не длиннее SSO-буфера std::string
+void Tokenize(std::string_view input, std::vector<Token>& tokens);
+
+void TokenizeCompact(std::string_view input, std::vector<CompactToken>& tokens);
+
+// Память под токены берется из resource, например из арены потока-обработчика
+std::pmr::vector<CompactToken> TokenizeCompact(std::string_view input, std::pmr::memory_resource* resource);
+
+// Ленивый поток токенов: разбирает строку по мере запроса, не складывая токены в вектор
+class TokenStream {
+  std::string_view input_;
+  size_t pos_ = 0;
+  CompactToken current_{};  // уже прочитанный, но ещё не выданный токен
+  bool has_current_ = false;
+
+  // Быстрый путь для самых частых токенов — оператора, скобки или числа до 9 цифр после не более
+  // чем одного пробела. Он встраивается прямо в цикл парсера, так что разбор таких выражений читает
+  // символы входа без вызова токенизатора; все остальное (слова, длинные числа, ошибки) уходит в
+  // общий путь AdvanceSlow
+  bool TryAdvanceFast() {
+    if (pos_ < input_.size() && input_[pos_] == ' ') {
+      ++pos_;
+    }
+    if (pos_ >= input_.size()) {
+      return false;
+    }
+    TokenKind kind = TokenKind::kUnknown;
+    switch (input_[pos_]) {
+      case '+':
+        kind = TokenKind::kPlus;
+        break;
+      case '-':
+        kind = TokenKind::kMinus;
+        break;
+      case '*':
+        kind = TokenKind::kMultiply;
+        break;
+      case '/':
+        kind = TokenKind::kDivide;
+        break;
+      case '%':
+        kind = TokenKind::kResidual;
+        break;
+      case '(':
+        kind = TokenKind::kOpeningBracket;
+        break;
+      case ')':
+        kind = TokenKind::kClosingBracket;
+        break;
+      default:
+        return TryAdvanceNumber();
+    }
+    current_ = {kind, 1, static_cast<uint32_t>(pos_), 0};
+    ++pos_;
+    has_current_ = true;
+    return true;
+  }
+
+  bool TryAdvanceNumber() {
+    constexpr size_t kMaxFastDigits = 9;  // 999'999'999 заведомо помещается в int
+    const auto is_digit = [](char symbol) { return symbol >= '0' && symbol <= '9'; };
+    const auto begin = pos_;
+    const auto limit = input_.size() - begin < kMaxFastDigits ? input_.size() : begin + kMaxFastDigits;
+    auto end = begin;
+    int32_t value = 0;
+    while (end < limit && is_digit(input_[end])) {
+      value = value * 10 + (input_[end] - '0');
+      ++end;
+    }
+    if (end == begin || (end < input_.size() && is_digit(input_[end]))) {
+      return false;
+    }
+    current_ = {TokenKind::kNumber, static_cast<uint32_t>(end - begin), static_cast<uint32_t>(begin), value};
+    pos_ = end;
+    has_current_ = true;
+    return true;
+  }
+
+  void AdvanceSlow();
+
+  void Advance() {
+    if (!TryAdvanceFast()) {
+      AdvanceSlow();
+    }
+  }
+
+ public:
+  explicit TokenStream(std::string_view input);
+
+  bool Empty() const {
+    return !has_current_;
+  }
+
+  const CompactToken& Peek() const {  // текущий токен без продвижения, поток не должен быть пуст
+    return current_;
+  }
+
+  CompactToken Next() {  // выдает текущий токен и переходит к следующему
+    const auto token = current_;
+    Advance();
+    return token;
+  }
+
+  std::string_view Text(const CompactToken& token) const {
+    return TokenText(token, input_);
+  }
+
+  size_t Offset() const {  // позиция текущего токена или конец строки, если поток пуст
+    return has_current_ ? current_.offset : input_.size();
+  }
+
+  // Дочитывает остаток входа, не выдавая токенов, и бросает TokenizeError на первой ошибке в нем.
+  // Вызывается перед сообщением об ошибке разбора: недопустимый символ в любом месте входа важнее
+  // ее, как и при токенизации всего входа заранее
+  void ScanRest();
+};
+
+// Токенизатор для входа, приходящего по частям (например, из буферов чтения сокета): фрагменты
+// разбираются по мере поступления без склейки в одну строку, а число или слово на границе
+// фрагментов откладывается до следующего вызова. Смещения токенов отсчитываются от начала всего
+// входа; на входе длиннее 4 ГБ в offset остаются младшие 32 бита, а полную позицию дает Position().
+// Из текста слов сохраняется только начало последнего слова, отложенного на границе фрагментов
+// (WordPrefix): остальной текст после разбора фрагмента можно получить только из собственных буферов
+// вызывающего
+class ChunkedTokenizer {
+  enum class State : uint8_t { kIdle, kNumber, kWord };
+
+  uint64_t position_ = 0;  // сколько байт уже подано
+  State state_ = State::kIdle;
+  uint64_t pending_begin_ = 0;   // начало отложенного числа или слова
+  uint64_t pending_length_ = 0;
+  std::string pending_text_;     // значащие цифры числа или начало слова
+  std::string word_prefix_;      // начало последнего отложенного слова
+  uint64_t word_begin_ = 0;
+
+  void Extend(std::string_view part);
+  CompactToken Flush();
+
+ public:
+  static constexpr size_t kWordPrefix = 64;  // сколько байт отложенного слова сохраняется
+
+  // Разбирает очередной фрагмент и дописывает готовые токены в tokens
+  void Feed(std::string_view chunk, std::vector<CompactToken>& tokens);
+
+  // Сообщает о конце входа и дописывает отложенный токен
+  void Finish(std::vector<CompactToken>& tokens);
+
+  uint64_t Position() const {
+    return position_;
+  }
+
+  // Первые kWordPrefix байт последнего слова, отложенного на границе фрагментов, и его позиция:
+  // по ним вызывающий получает текст слова, начало которого уже не лежит в его буферах
+  std::string_view WordPrefix() const {
+    return word_prefix_;
+  }
+
+  uint64_t WordBegin() const {
+    return word_begin_;
+  }
+};
+
+// Поток токенов из std::istream с тем же интерфейсом, что и у TokenStream: вход читается фрагментами
+// по chunk_size байт и разбирается ChunkedTokenizer, так что в памяти одновременно лежат только
+// три последних фрагмента и токены одного из них. Смещения токенов на входе длиннее 4 ГБ
+// 32-битные (см. ChunkedTokenizer), а от слова, начавшегося раньше трех последних фрагментов,
+// Text возвращает только первые ChunkedTokenizer::kWordPrefix байт
+class ChunkedTokenStream {
+  std::istream& input_;
+  size_t chunk_size_;
+  ChunkedTokenizer tokenizer_;
+  std::string older_;     // два предыдущих фрагмента: слово, законченное следующим фрагментом,
+  std::string previous_;  // могло начаться в позапрошлом
+  std::string buffer_;    // текущий фрагмент
+  std::string spare_;     // буфер для чтения следующего фрагмента
+  std::vector<CompactToken> tokens_;
+  size_t next_ = 0;
+  bool finished_ = false;
+  std::string carry_;  // текст токена, пересекающего границу фрагментов
+
+  void Refill();
+
+ public:
+  static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+  explicit ChunkedTokenStream(std::istream& input, size_t chunk_size = kDefaultChunkSize);
+
+  bool Empty() {  // дочитывает вход, если токены текущего фрагмента кончились
+    if (next_ == tokens_.size() && !finished_) {
+      Refill();
+    }
+    return next_ == tokens_.size();
+  }
+
+  const CompactToken& Peek() const {  // поток не должен быть пуст
+    return tokens_[next_];
+  }
+
+  CompactToken Next() {
+    return tokens_[next_++];
+  }
+
+  // Текст токена из последних трех фрагментов. Обычно это ссылка на фрагмент, где лежит токен,
+  // и она действительна до следующего чтения входа; токен на границе фрагментов копируется
+  // в carry_, и такая ссылка действительна до следующего вызова Text
+  std::string_view Text(const CompactToken& token);
+
+  size_t Offset() {  // позиция текущего токена или конец входа, если поток пуст
+    return Empty() ? tokenizer_.Position() : Peek().offset;
+  }
+
+  void ScanRest();  // то же, что TokenStream::ScanRest: дочитывает вход до конца
+};
+
+// Курсор по готовому вектору Token с тем же интерфейсом, что и у TokenStream.
+// Положения в строке у Token нет, поэтому offset токена — его индекс в векторе, а length равна 1
+class TokenCursor {
+  const std::vector<Token>& tokens_;
+  size_t& pos_;
+
+ public:
+  TokenCursor(const std::vector<Token>& tokens, size_t& pos) : tokens_(tokens), pos_(pos) {
+  }
+
+  bool Empty() const {
+    return pos_ >= tokens_.size();
+  }
+
+  CompactToken Peek() const {
+    const auto& token = tokens_[pos_];
+    const auto kind = static_cast<TokenKind>(token.index());
+    const auto* number = std::get_if<NumberToken>(&token);
+    return {kind, 1, static_cast<uint32_t>(pos_), number ? number->value : 0};
+  }
+
+  CompactToken Next() {
+    const auto token = Peek();
+    ++pos_;
+    return token;
+  }
+
+  std::string_view Text(const CompactToken& token) const {
+    return std::get<UnknownToken>(tokens_[token.offset]).value;
+  }
+
+  size_t Offset() const {
+    return pos_;
+  }
+};
+
+#endif  // MY_TOKENIZE_H
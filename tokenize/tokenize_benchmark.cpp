@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Bulat Ibragimov, Irina Selyakh
+//
+// Данное программное обеспечение распространяется на условиях лицензии MIT.
+// Подробности смотрите в файле LICENSE
+
+#include "tokenize.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+// Генерация длинного выражения из чисел, операторов, скобок и функций.
+// max_spaces задает длину серий пробелов, а max_zeros — число ведущих нулей у чисел
+static std::string GenerateExpression(size_t size, size_t max_spaces, size_t max_zeros) {
+  static constexpr std::string_view kParts[] = {"+", "-", "*", "/", "%", "(", ")", "min", "max", "abs", "sqr"};
+  std::mt19937 generator(42);
+  std::string input;
+  while (input.size() < size) {
+    if (generator() % 2 == 0) {
+      input.append(generator() % (max_zeros + 1), '0');
+      input += std::to_string(generator() % 100000);
+    } else {
+      input += kParts[generator() % std::size(kParts)];
+    }
+    input.append(1 + generator() % max_spaces, ' ');
+  }
+  return input;
+}
+
+// Возвращает скорость токенизации в мегабайтах в секунду (лучшая из нескольких попыток)
+template <class Function>
+static double Measure(std::string_view input, Function function) {
+  constexpr size_t kAttempts = 5;
+  constexpr size_t kRepeats = 10;
+  double best = 0;
+  for (size_t attempt = 0; attempt < kAttempts; ++attempt) {
+    const auto start = std::chrono::steady_clock::now();
+    size_t total_tokens = 0;
+    for (size_t i = 0; i < kRepeats; ++i) {
+      total_tokens += function(input);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (total_tokens == 0) {
+      std::cout << "no tokens\n";
+    }
+    best = std::max(best, static_cast<double>(input.size() * kRepeats) / elapsed.count() / 1e6);
+  }
+  return best;
+}
+
+static void Run(const std::string& title, std::string_view input) {
+  std::cout << title << '\n';
+  std::cout << "  Tokenize:         " << Measure(input, [](std::string_view text) { return Tokenize(text).size(); })
+            << " MB/s\n";
+  std::cout << "  TokenizeCompact:  "
+            << Measure(input, [](std::string_view text) { return TokenizeCompact(text).size(); }) << " MB/s\n";
+  std::cout << "  TokenizeParallel: "
+            << Measure(input, [](std::string_view text) { return TokenizeParallel(text).size(); }) << " MB/s\n";
+  std::cout << "  TokenStream:      " << Measure(input, [](std::string_view text) {
+    size_t count = 0;
+    for (TokenStream stream(text); !stream.Empty(); stream.Next()) {
+      ++count;
+    }
+    return count;
+  }) << " MB/s\n";
+}
+
+int main() {
+  constexpr size_t kSize = 1 << 20;
+  Run("short runs", GenerateExpression(kSize, 3, 0));
+  Run("long runs", GenerateExpression(kSize, 64, 40));
+  return 0;
+}
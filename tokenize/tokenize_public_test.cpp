@@ -6,6 +6,7 @@
 
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
+#include <sstream>
 #include "tokenize.h"
 
 void Equal(const std::vector<Token> &fact, const std::vector<Token> &expected) {
@@ -58,3 +59,276 @@ TEST_CASE("Numbers", "[Tokenize]") {
         {PlusToken{}, NumberToken{11}, MinusToken{}, NumberToken{12}, PlusToken{}, PlusToken{}, NumberToken{11},
          MinusToken{}, MinusToken{}, NumberToken{12}});
 }
+
+TEST_CASE("Stream", "[TokenStream]") {
+  const auto check = [](std::string_view input) {
+    TokenStream stream(input);
+    std::vector<Token> tokens;
+    while (!stream.Empty()) {
+      tokens.push_back(ToToken(stream.Next(), input));
+    }
+    Equal(tokens, Tokenize(input));
+  };
+  check("");
+  check("   ");
+  check("  +  - *   / %  min max   abs (   sqr 1 )     ");
+  check(" ++ -- *+ absmin minmax *3 sqr1 ");
+  check("  +11  -33 -0  +0  11+  12- 23-4 1+1-1");
+
+  TokenStream stream("min 1 foo");
+  REQUIRE(stream.Peek().kind == TokenKind::kMin);
+  REQUIRE(stream.Next().kind == TokenKind::kMin);
+  REQUIRE(stream.Next().value == 1);
+  REQUIRE(stream.Text(stream.Next()) == "foo");
+  REQUIRE(stream.Empty());
+}
+
+TEST_CASE("Compact", "[TokenizeCompact]") {
+  const std::string_view input = " + 12 aba min ( ";
+  const auto tokens = TokenizeCompact(input);
+  REQUIRE(tokens.size() == 5);
+  REQUIRE(tokens[0].kind == TokenKind::kPlus);
+  REQUIRE(tokens[1].kind == TokenKind::kNumber);
+  REQUIRE(tokens[1].value == 12);
+  REQUIRE(tokens[1].offset == 3);
+  REQUIRE(tokens[1].length == 2);
+  REQUIRE(tokens[2].kind == TokenKind::kUnknown);
+  REQUIRE(TokenText(tokens[2], input) == "aba");
+  REQUIRE(tokens[3].kind == TokenKind::kMin);
+  REQUIRE(TokenText(tokens[3], input) == "min");
+  REQUIRE(TokenText(tokens[4], input) == "(");
+  REQUIRE(tokens[4].kind == TokenKind::kOpeningBracket);
+
+  std::vector<Token> view;
+  for (const auto& token : tokens) {
+    view.push_back(ToToken(token, input));
+  }
+  Equal(view, Tokenize(input));
+}
+
+TEST_CASE("LongRuns", "[Tokenize]") {
+  for (size_t length = 1; length < 100; ++length) {
+    const std::string spaces(length, ' ');
+    const std::string zeros(length, '0');
+    const std::string word(length, 'x');
+    Equal(Tokenize(spaces + "+" + spaces + "\t\n\v\f\r" + spaces), {PlusToken{}});
+    Equal(Tokenize(zeros + "42" + spaces + zeros), {NumberToken{42}, NumberToken{0}});
+    Equal(Tokenize(word + "Y" + zeros + "7" + word), {UnknownToken{word + "Y"}, NumberToken{7}, UnknownToken{word}});
+    Equal(Tokenize(spaces + "min" + spaces + "(" + word + ")"),
+          {MinToken{}, OpeningBracketToken{}, UnknownToken{word}, ClosingBracketToken{}});
+    REQUIRE_THROWS_AS(Tokenize(word + "\x80" + word), std::runtime_error);
+    REQUIRE_THROWS_AS(Tokenize(zeros + "[" + zeros), std::runtime_error);
+  }
+}
+
+TEST_CASE("LargeNumbers", "[Tokenize]") {
+  Equal(Tokenize("12345678 123456789 1234567890 2147483647"),
+        {NumberToken{12345678}, NumberToken{123456789}, NumberToken{1234567890}, NumberToken{2147483647}});
+  Equal(Tokenize("00000000000000000000000002147483647 000000000 0000000010"),
+        {NumberToken{2147483647}, NumberToken{0}, NumberToken{10}});
+  Equal(Tokenize("98765432+87654321*7654321-654321"),
+        {NumberToken{98765432}, PlusToken{}, NumberToken{87654321}, MultiplyToken{}, NumberToken{7654321},
+         MinusToken{}, NumberToken{654321}});
+
+  const auto position_of_error = [](std::string_view input) -> size_t {
+    try {
+      Tokenize(input);
+    } catch (const TokenizeError& error) {
+      return error.Position();
+    }
+    return std::string_view::npos;
+  };
+  REQUIRE(position_of_error("1 + 2147483648") == 4);
+  REQUIRE(position_of_error("  99999999999") == 2);
+  REQUIRE(position_of_error("1 + 1000000000000000000000000000000") == 4);
+  REQUIRE(position_of_error("12 ! 3") == 3);
+  REQUIRE(position_of_error("12 + 3") == std::string_view::npos);
+}
+
+TEST_CASE("Keywords", "[RegisterKeyword]") {
+  Equal(Tokenize("minimum sqrt"), {UnknownToken{"minimum"}, UnknownToken{"sqrt"}});
+
+  RegisterKeyword("minimum", TokenKind::kMin);
+  RegisterKeyword("sqrt", TokenKind::kSqr);
+  RegisterKeyword("mxn", TokenKind::kMax);  // совпадает с "min" по длине, первой и последней букве
+  RegisterKeyword("mian", TokenKind::kMax);
+  RegisterKeyword("moan", TokenKind::kMin);  // совпадает с "mian" по длине, первой, средней и последней букве
+  Equal(Tokenize("minimum sqrt min max abs sqr mxn mian moan mun"),
+        {MinToken{}, SqrToken{}, MinToken{}, MaxToken{}, AbsToken{}, SqrToken{}, MaxToken{}, MaxToken{}, MinToken{},
+         UnknownToken{"mun"}});
+
+  for (char first = 'a'; first <= 'z'; ++first) {
+    for (char last = 'a'; last <= 'z'; last += 5) {
+      RegisterKeyword(std::string{first, 'q', 'q', last}, TokenKind::kAbs);
+    }
+  }
+  Equal(Tokenize("aqqa zqqz minimum bqqc"), {AbsToken{}, AbsToken{}, MinToken{}, UnknownToken{"bqqc"}});
+
+  RegisterKeyword("minimum", TokenKind::kMax);
+  Equal(Tokenize("minimum"), {MaxToken{}});
+
+  REQUIRE_THROWS_AS(RegisterKeyword("", TokenKind::kMin), std::invalid_argument);
+  REQUIRE_THROWS_AS(RegisterKeyword("min2", TokenKind::kMin), std::invalid_argument);
+  REQUIRE_THROWS_AS(RegisterKeyword("seven", TokenKind::kNumber), std::invalid_argument);
+}
+
+TEST_CASE("CallerStorage", "[Tokenize]") {
+  const std::string_view input = " 1 + abc * ( 22 - 3 ) ";
+  const auto expected = TokenizeCompact(input);
+
+  std::vector<CompactToken> buffer;
+  TokenizeCompact(input, buffer);
+  REQUIRE(buffer == expected);
+  const auto* data = buffer.data();
+  buffer.clear();
+  TokenizeCompact(input, buffer);
+  REQUIRE(buffer == expected);
+  REQUIRE(buffer.data() == data);  // буфер переиспользован без перевыделения
+  TokenizeCompact(input, buffer);
+  REQUIRE(buffer.size() == 2 * expected.size());
+
+  std::vector<Token> tokens{MinToken{}};
+  Tokenize("1 abc", tokens);
+  Equal(tokens, {MinToken{}, NumberToken{1}, UnknownToken{"abc"}});
+
+  // арена без запасного ресурса: выход за пределы буфера привел бы к std::bad_alloc
+  std::array<std::byte, 4096> storage;
+  std::pmr::monotonic_buffer_resource arena(storage.data(), storage.size(), std::pmr::null_memory_resource());
+  auto arena_tokens = TokenizeCompact(input, &arena);
+  REQUIRE(arena_tokens.get_allocator().resource() == &arena);
+  REQUIRE(std::equal(arena_tokens.begin(), arena_tokens.end(), expected.begin(), expected.end()));
+}
+
+TEST_CASE("Chunked", "[ChunkedTokenizer]") {
+  const std::string input = "  min(12 + 0003400) * abs  maxi - 0000000000000000000002147483647 / sqr xyzzy 7  ";
+  const auto expected = TokenizeCompact(input);
+  for (size_t step = 1; step <= input.size(); ++step) {
+    ChunkedTokenizer tokenizer;
+    std::vector<CompactToken> tokens;
+    for (size_t pos = 0; pos < input.size(); pos += step) {
+      tokenizer.Feed(std::string_view(input).substr(pos, step), tokens);
+    }
+    tokenizer.Feed("", tokens);
+    tokenizer.Finish(tokens);
+    REQUIRE(tokens == expected);
+    REQUIRE(tokenizer.Position() == input.size());
+  }
+
+  ChunkedTokenizer tokenizer;
+  std::vector<CompactToken> tokens;
+  tokenizer.Feed("1 + 21474", tokens);
+  try {
+    tokenizer.Feed("836", tokens);
+    tokenizer.Feed("48", tokens);
+    tokenizer.Finish(tokens);
+    FAIL("overflow is not detected");
+  } catch (const TokenizeError& error) {
+    REQUIRE(error.Position() == 4);
+  }
+
+  ChunkedTokenizer unknown;
+  unknown.Feed("1 + 2", tokens);
+  try {
+    unknown.Feed(" $", tokens);
+    FAIL("unknown symbol is not detected");
+  } catch (const TokenizeError& error) {
+    REQUIRE(error.Position() == 6);
+  }
+}
+
+TEST_CASE("Parallel", "[TokenizeParallel]") {
+  std::string input;
+  for (size_t i = 0; input.size() < (1 << 19); ++i) {
+    input += std::to_string(i * 7919) + (i % 3 == 0 ? " + " : "*") + (i % 5 == 0 ? "abs" : "") + "(x" +
+             std::string(i % 4, 'y') + ") - ";
+  }
+  input += "1";
+  const auto expected = TokenizeCompact(input);
+  for (size_t threads : {1, 2, 3, 4, 8}) {
+    REQUIRE(TokenizeParallel(input, threads) == expected);
+  }
+  REQUIRE(TokenizeParallel("1 + 2") == TokenizeCompact("1 + 2"));
+
+  auto broken = input;
+  broken[broken.size() / 3] = '$';
+  broken[broken.size() / 3 * 2] = '$';
+  try {
+    TokenizeParallel(broken, 4);
+    FAIL("unknown symbol is not detected");
+  } catch (const TokenizeError& error) {
+    REQUIRE(error.Position() == broken.size() / 3);
+  }
+}
+
+TEST_CASE("StreamFastPath", "[TokenStream]") {
+  const auto check = [](std::string_view input) {
+    TokenStream stream(input);
+    std::vector<CompactToken> tokens;
+    while (!stream.Empty()) {
+      tokens.push_back(stream.Next());
+    }
+    REQUIRE(tokens == TokenizeCompact(input));
+  };
+  check("1 + 22 * (333 - 4444) / 55555 % 666666");
+  check("999999999 1000000000 0000000001 007 0 000000000000000000042");
+  check("123456789abs 12345678 9 (1)(2)) 2147483647");
+  check("1 \t 2\n3  4 ");
+
+  for (const auto* input : {"1 + 2147483648", "12345678901", "1 + 2 $"}) {
+    REQUIRE_THROWS_AS(
+        [input] {
+          TokenStream stream(input);
+          while (!stream.Empty()) {
+            stream.Next();
+          }
+        }(),
+        TokenizeError);
+  }
+}
+
+TEST_CASE("ChunkedStream", "[ChunkedTokenStream]") {
+  const std::string input = " + 12 aba min ( 1234567890 )  foo   sqr   1 % 2147483647 qwertyuiop ";
+  for (size_t chunk_size : {1, 2, 3, 5, 8, 100}) {
+    std::istringstream source(input);
+    ChunkedTokenStream stream(source, chunk_size);
+    std::vector<CompactToken> tokens;
+    std::vector<std::string> words;
+    while (!stream.Empty()) {
+      REQUIRE(stream.Offset() == stream.Peek().offset);
+      tokens.push_back(stream.Next());
+      if (tokens.back().kind == TokenKind::kUnknown) {
+        words.emplace_back(stream.Text(tokens.back()));
+      }
+    }
+    REQUIRE(tokens == TokenizeCompact(input));
+    REQUIRE(stream.Offset() == input.size());
+    REQUIRE(words == std::vector<std::string>{"aba", "foo", "qwertyuiop"});
+  }
+}
+
+TEST_CASE("ChunkedStreamWords", "[ChunkedTokenStream]") {
+  const auto words_of = [](const std::string& input, size_t chunk_size) {
+    std::istringstream source(input);
+    ChunkedTokenStream stream(source, chunk_size);
+    std::vector<std::string> words;
+    while (!stream.Empty()) {
+      const auto token = stream.Next();
+      if (token.kind == TokenKind::kUnknown) {
+        words.emplace_back(stream.Text(token));
+      }
+    }
+    return words;
+  };
+  // слово длиннее двух фрагментов и пробелы на несколько фрагментов: начало слова уже не в буферах
+  for (size_t chunk_size : {1, 2, 3, 4}) {
+    INFO(chunk_size);
+    REQUIRE(words_of("abcdefghijkl          foo        max", chunk_size) ==
+            std::vector<std::string>{"abcdefghijkl", "foo"});
+    REQUIRE(words_of("foo   max", chunk_size) == std::vector<std::string>{"foo"});
+  }
+  // от длинного слова остается только его начало
+  const std::string long_word(1000, 'q');
+  REQUIRE(words_of(long_word + "   1", 8) ==
+          std::vector<std::string>{std::string(ChunkedTokenizer::kWordPrefix, 'q')});
+  REQUIRE(words_of(long_word, 8) == std::vector<std::string>{std::string(ChunkedTokenizer::kWordPrefix, 'q')});
+}